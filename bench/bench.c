@@ -0,0 +1,609 @@
+// ============================================================================
+// Host-side render/encode benchmark
+// ============================================================================
+// Compiles the watch sources against bench/pebble.h and reports, per format
+// and payload size: wall time per barcode_draw, graphics_fill_rect calls and
+// pixels touched; plus qr_generate_packed throughput and storage cost.
+//
+// Usage: bench_<platform> [iterations]
+
+#include "common.h"
+#include <stdlib.h>
+#include <time.h>
+
+// main.c is not part of the bench build; it owns these globals on the watch.
+CardRef g_card_refs[MAX_CARDS];
+int g_card_count = 0;
+const CardPayload *g_active_card = NULL;
+bool g_invert_colors = false;
+bool g_sort_by_use = false;
+uint8_t g_quick_launch = QUICK_LAUNCH_OFF;
+
+static int s_iterations = 200;
+static int s_failures = 0; // Budget checks that failed: the exit status
+
+// --- Helpers ---
+
+static uint32_t s_rng = 0x12345678;
+
+static uint32_t rng_next(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void set_bit(uint8_t *bits, int idx) {
+    bits[idx / 8] |= (1 << (7 - (idx % 8)));
+}
+
+static int packed_len(int w, int h) {
+    return (w * h + 7) / 8;
+}
+
+// 1D symbol as bwip-js crops it: alternating bar/space runs of 1-4 modules,
+// starting and ending with a bar, repeated on every row.
+static void make_1d(uint8_t *bits, int w, int h) {
+    memset(bits, 0, MAX_BITS_LEN);
+    uint8_t row[MAX_BITS_LEN * 8];
+    int c = 0;
+    bool black = true;
+    while (c < w) {
+        int run = 1 + rng_next() % 4;
+        for (int i = 0; i < run && c < w; i++, c++) row[c] = black;
+        black = !black;
+    }
+    row[w - 1] = 1;
+    for (int r = 0; r < h; r++)
+        for (int i = 0; i < w; i++)
+            if (row[i]) set_bit(bits, r * w + i);
+}
+
+// Random 2D matrix at ~50% density, each module row repeated row_mult times
+// (PDF417 rows are 3px tall in the phone bitmap).
+static void make_2d(uint8_t *bits, int w, int h, int row_mult) {
+    memset(bits, 0, MAX_BITS_LEN);
+    for (int r = 0; r < h; r += row_mult) {
+        for (int c = 0; c < w; c++) {
+            if (rng_next() & 1) {
+                for (int k = 0; k < row_mult && r + k < h; k++) set_bit(bits, (r + k) * w + c);
+            }
+        }
+    }
+}
+
+static bool get_bit(const uint8_t *bits, int idx) {
+    return bits[idx / 8] & (1 << (7 - (idx % 8)));
+}
+
+static int put_varint(uint8_t *out, int pos, uint32_t v) {
+    while (v >= 0x80) {
+        out[pos++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[pos++] = (uint8_t)v;
+    return pos;
+}
+
+// ENCODING_ROW_RLE, as cropBitmap's encoder on the phone produces it
+static int encode_row_rle(const uint8_t *bits, int w, int h, uint8_t *out, int max_len) {
+    static uint8_t runs[MAX_BITS_LEN * 2];
+    int pos = 0;
+    for (int r = 0; r < h;) {
+        int repeat = 1;
+        while (r + repeat < h) {
+            bool same = true;
+            for (int c = 0; c < w && same; c++) same = get_bit(bits, r * w + c) == get_bit(bits, (r + repeat) * w + c);
+            if (!same) break;
+            repeat++;
+        }
+
+        int runs_len = 0;
+        bool black = false;
+        for (int c = 0; c < w;) {
+            int run = 0;
+            while (c + run < w && get_bit(bits, r * w + c + run) == black) run++;
+            runs_len = put_varint(runs, runs_len, run);
+            c += run;
+            black = !black;
+        }
+
+        int raw_len = (w + 7) / 8;
+        bool raw = raw_len < runs_len;
+        if (pos + 5 + (raw ? raw_len : runs_len) > max_len) return -1;
+        pos = put_varint(out, pos, (uint32_t)repeat << 1 | (raw ? 1 : 0));
+        if (raw) {
+            memset(out + pos, 0, raw_len);
+            for (int c = 0; c < w; c++) {
+                if (get_bit(bits, r * w + c)) out[pos + c / 8] |= (uint8_t)(1 << (7 - c % 8));
+            }
+            pos += raw_len;
+        } else {
+            memcpy(out + pos, runs, runs_len);
+            pos += runs_len;
+        }
+        r += repeat;
+    }
+    return pos;
+}
+
+// --- Render Cases ---
+
+typedef struct {
+    const char *label;
+    BarcodeFormat format;
+    uint16_t w, h;
+    int bytes;
+} RenderCase;
+
+static void run_render_case(const RenderCase *rc, const uint8_t *bits) {
+    GContext *ctx = fake_gcontext();
+    GRect bounds = fake_screen_bounds();
+    CardEncoding encoding = rc->w ? ENCODING_PACKED : ENCODING_TEXT;
+
+    // Warm-up pass also captures the per-draw counters.
+    fake_counters_reset();
+    barcode_draw(ctx, bounds, rc->format, encoding, rc->w, rc->h, bits, MAX_BITS_LEN, NULL);
+    FakeCounters per_draw = g_fake_counters;
+    uint32_t fb_hash = fake_framebuffer_hash();
+
+    // Timed with the edge table the card cache builds at load, as on the watch
+    static ModuleEdges edges;
+    barcode_build_edges(bounds, rc->format, encoding, rc->w, rc->h, bits, MAX_BITS_LEN, &edges);
+    barcode_draw(ctx, bounds, rc->format, encoding, rc->w, rc->h, bits, MAX_BITS_LEN, &edges);
+    if (fake_framebuffer_hash() != fb_hash) printf("  %s: edge table draw MISMATCH\n", rc->label);
+    double t0 = now_us();
+    for (int i = 0; i < s_iterations; i++) {
+        barcode_draw(ctx, bounds, rc->format, encoding, rc->w, rc->h, bits, MAX_BITS_LEN, &edges);
+    }
+    double us = (now_us() - t0) / s_iterations;
+
+    // Same card replayed from a display list compiled for this screen
+    char replay[40] = "     -          -";
+#if WALLET_DISPLAY_LISTS
+    static uint8_t dlist[DLIST_MAX_LEN];
+    int dlist_len = barcode_compile_display_list(bounds, rc->format, encoding, rc->w, rc->h,
+                                                 bits, MAX_BITS_LEN, dlist, sizeof(dlist));
+    if (dlist_len > 0) {
+        barcode_draw_display_list(ctx, bounds, dlist, dlist_len);
+        bool match = (fake_framebuffer_hash() == fb_hash);
+        t0 = now_us();
+        for (int i = 0; i < s_iterations; i++) barcode_draw_display_list(ctx, bounds, dlist, dlist_len);
+        double replay_us = (now_us() - t0) / s_iterations;
+        // What the watch would store: main.c's compile_display_lists
+        bool kept = barcode_display_list_pays(rc->format) && dlist_len < rc->bytes;
+        snprintf(replay, sizeof(replay), "%6d %10.2f %s%s", dlist_len, replay_us, match ? "ok" : "MISMATCH",
+                 kept ? " kept" : "");
+    }
+#endif
+
+    // Same card sent as ENCODING_ROW_RLE and decoded while drawing
+    static uint8_t rle[MAX_BITS_LEN * 2];
+    char rle_col[40] = "     -          -";
+    int rle_len = rc->w ? encode_row_rle(bits, rc->w, rc->h, rle, sizeof(rle)) : -1;
+    if (rle_len > 0) {
+        barcode_draw(ctx, bounds, rc->format, ENCODING_ROW_RLE, rc->w, rc->h, rle, rle_len, NULL);
+        bool match = (fake_framebuffer_hash() == fb_hash);
+        t0 = now_us();
+        for (int i = 0; i < s_iterations; i++) {
+            barcode_draw(ctx, bounds, rc->format, ENCODING_ROW_RLE, rc->w, rc->h, rle, rle_len, NULL);
+        }
+        double rle_us = (now_us() - t0) / s_iterations;
+        snprintf(rle_col, sizeof(rle_col), "%6d %10.2f %s", rle_len, rle_us, match ? "ok" : "MISMATCH");
+    }
+
+    char dims[16];
+    if (rc->w) snprintf(dims, sizeof(dims), "%ux%u", rc->w, rc->h);
+    else snprintf(dims, sizeof(dims), "text");
+    printf("  %-22s %-9s %6d %10.2f %8u %9u  %08x  %-28s %s\n", rc->label, dims, rc->bytes, us,
+           per_draw.fill_rect_calls, per_draw.pixels_touched, fb_hash, replay, rle_col);
+}
+
+static void bench_render(void) {
+    static uint8_t bits[MAX_BITS_LEN];
+    printf("barcode_draw\n");
+    printf("  %-22s %-9s %6s %10s %8s %9s  %-8s  %6s %-21s %6s %10s\n", "case", "modules", "bytes", "us/draw", "rects",
+           "pixels", "fb hash", "dlist", " us/replay", "rle", "us/draw");
+
+    static const struct { const char *label; uint16_t w; } ONE_D[] = {
+        {"1D EAN-13", 95}, {"1D Code128 short", 145}, {"1D Code128 long", 148},
+        {"1D Code128 too long", 211}, // Past 168px less quiet zones: the message
+    };
+    for (unsigned i = 0; i < sizeof(ONE_D) / sizeof(ONE_D[0]); i++) {
+        RenderCase rc = {ONE_D[i].label, FORMAT_CODE128, ONE_D[i].w, 10, packed_len(ONE_D[i].w, 10)};
+        make_1d(bits, rc.w, rc.h);
+        run_render_case(&rc, bits);
+    }
+
+#if WALLET_TEXT_ENCODERS // Otherwise QR modules only come from the phone
+    static const char *QR_TEXT[] = {
+        "HTTPS://EX.CO", "MEMBER 0042-7781-9922 GOLD TIER", "TICKET 8812 ROW 14 SEAT 22 GATE B DOOR 4 ENTRY AFTER 18:30",
+        "LOYALTY CARD 5512 8823 1190 0042 ISSUED BY EXAMPLE STORES PLC VALID UNTIL 2030 - PRESENT AT TILL 12 34",
+        "https://tickets.example.com/event/2291/order/77812?seat=A14&gate=B&door=4&token=f81c9e02a7d4",
+    };
+    for (unsigned i = 0; i < sizeof(QR_TEXT) / sizeof(QR_TEXT[0]); i++) {
+        uint8_t size = 0;
+        memset(bits, 0, sizeof(bits));
+        if (!qr_generate_packed(QR_TEXT[i], strlen(QR_TEXT[i]), bits, &size)) continue;
+        char label[32];
+        snprintf(label, sizeof(label), "QR v%d", (size - 17) / 4);
+        RenderCase rc = {label, FORMAT_QR, size, size, packed_len(size, size)};
+        run_render_case(&rc, bits);
+    }
+#endif
+
+    static const uint16_t AZTEC[] = {15, 19, 23, 27, 41};
+    for (unsigned i = 0; i < sizeof(AZTEC) / sizeof(AZTEC[0]); i++) {
+        RenderCase rc = {"Aztec", FORMAT_AZTEC, AZTEC[i], AZTEC[i], packed_len(AZTEC[i], AZTEC[i])};
+        make_2d(bits, rc.w, rc.h, 1);
+        run_render_case(&rc, bits);
+    }
+
+    static const uint16_t PDF_ROWS[] = {10, 20};
+    for (unsigned i = 0; i < sizeof(PDF_ROWS) / sizeof(PDF_ROWS[0]); i++) {
+        RenderCase rc = {"PDF417 2col", FORMAT_PDF417, 103, PDF_ROWS[i] * 3, packed_len(103, PDF_ROWS[i] * 3)};
+        make_2d(bits, rc.w, rc.h, 3);
+        run_render_case(&rc, bits);
+    }
+
+    static const struct { const char *label; BarcodeFormat format; const char *text; } TEXT[] = {
+        {"text Code128 C", FORMAT_CODE128, "1234567890123456"},
+        {"text Code128 B", FORMAT_CODE128, "ABC-12-xy"},
+        {"text Code128 long", FORMAT_CODE128, "AB12345678901234"},           // 148 modules
+        {"text Code128 too long", FORMAT_CODE128, "MEMBER-0042-7781-AB"},    // 244
+        {"text Code39", FORMAT_CODE39, "MEM42AB"},
+        {"text EAN-13", FORMAT_EAN13, "590123412345"},
+        {"text UPC-A", FORMAT_UPCA, "036000291452"},
+        {"text EAN-8", FORMAT_EAN8, "9638507"},
+        {"text QR", FORMAT_QR, "HELLO WORLD 12345"},
+        {"text Aztec", FORMAT_AZTEC, "HELLO WORLD 12345"},
+        {"text Aztec mixed", FORMAT_AZTEC, "Ticket #8812, Row 14: seat 22 / gate B"},
+    };
+    for (unsigned i = 0; i < sizeof(TEXT) / sizeof(TEXT[0]); i++) {
+        memset(bits, 0, sizeof(bits));
+        strncpy((char *)bits, TEXT[i].text, MAX_DATA_LEN);
+        RenderCase rc = {TEXT[i].label, TEXT[i].format, 0, 0, (int)strlen(TEXT[i].text)};
+        run_render_case(&rc, bits);
+    }
+}
+
+#if WALLET_TEXT_ENCODERS
+// --- QR Generator ---
+// "first" is a text's first generation, mask selection included; "again"
+// the same text once its mask is memoized (redraws, flips back), which must
+// stay within QR_AGAIN_BUDGET of generating with a fixed mask.
+
+bool qr_generate_packed_mask0(const char *data, int len, uint8_t *output_buffer, uint8_t *out_size);
+bool qr_generate_packed_select(const char *data, int len, uint8_t *output_buffer, uint8_t *out_size);
+
+#define QR_AGAIN_BUDGET 1.25
+
+typedef bool (*QrGenerateFn)(const char *data, int len, uint8_t *output_buffer, uint8_t *out_size);
+
+// Best of QR_BATCHES batches, the generators taking turns: the budget check
+// shouldn't trip on scheduler noise
+#define QR_BATCHES 9
+#define QR_MIN_CALLS 200 // Per batch, however few iterations were asked for
+
+static void time_qr(const QrGenerateFn *fns, double *best_us, int count, const char *text, int len, int n) {
+    static uint8_t out[QR_PACKED_MAX_LEN];
+    uint8_t size;
+    for (int batch = 0; batch < QR_BATCHES; batch++) {
+        for (int f = 0; f < count; f++) {
+            double t0 = now_us();
+            for (int k = 0; k < n; k++) fns[f](text, len, out, &size);
+            double us = (now_us() - t0) / n;
+            if (batch == 0 || us < best_us[f]) best_us[f] = us;
+        }
+    }
+}
+
+static void bench_qr(void) {
+    static const struct { int len; const char *charset; const char *kind; } INPUTS[] = {
+        {10, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:", "alnum"},
+        {25, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:", "alnum"},
+        {47, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:", "alnum"},
+        {77, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:", "alnum"},
+        {114, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:", "alnum"},
+        {20, "0123456789", "numeric"},
+        {60, "abcdefghijklmnopqrstuvwxyz0123456789/?=&.:", "byte"},
+        {150, "abcdefghijklmnopqrstuvwxyz0123456789/?=&.:", "byte"},
+        {270, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:", "alnum"},
+    };
+    printf("qr_generate_packed (mask0: fixed mask 0, no selection)\n");
+    printf("  %-22s %6s %10s %8s %10s %10s  %s\n", "input", "size", "first us", "select", "again us",
+           "mask0 us", "check");
+
+    for (unsigned i = 0; i < sizeof(INPUTS) / sizeof(INPUTS[0]); i++) {
+        char text[300];
+        int charset_len = strlen(INPUTS[i].charset);
+        for (int k = 0; k < INPUTS[i].len; k++) text[k] = INPUTS[i].charset[rng_next() % charset_len];
+        text[INPUTS[i].len] = '\0';
+
+        char label[32];
+        snprintf(label, sizeof(label), "%d chars %s", INPUTS[i].len, INPUTS[i].kind);
+        static uint8_t out[QR_PACKED_MAX_LEN];
+        uint8_t size = 0;
+        if (!qr_generate_packed(text, INPUTS[i].len, out, &size)) {
+            printf("  %-22s failed\n", label);
+            s_failures++;
+            continue;
+        }
+        static const QrGenerateFn FNS[] = { qr_generate_packed_select, qr_generate_packed, qr_generate_packed_mask0 };
+        double us[3];
+        time_qr(FNS, us, 3, text, INPUTS[i].len, s_iterations < QR_MIN_CALLS ? QR_MIN_CALLS : s_iterations);
+        double us_first = us[0], us_again = us[1], us_mask0 = us[2];
+        bool ok = us_again <= us_mask0 * QR_AGAIN_BUDGET;
+        if (!ok) s_failures++;
+        printf("  %-22s %3dx%-2d %10.2f %7.0f%% %10.2f %10.2f  %s\n", label, size, size, us_first,
+               100.0 * (us_first - us_mask0) / us_first, us_again, us_mask0, ok ? "ok" : "SLOW");
+    }
+}
+
+#endif
+
+// --- Invert ---
+// Cost of the XOR pass against drawing the card, and that it flips exactly
+// every visible pixel (twice restores the frame).
+
+static bool s_pixels[200][200];
+
+static void bench_invert(void) {
+    static uint8_t bits[MAX_BITS_LEN];
+    GContext *ctx = fake_gcontext();
+    GRect bounds = fake_screen_bounds();
+    printf("barcode_invert\n");
+    printf("  %-22s %10s %10s %8s  %s\n", "case", "us/draw", "us/invert", "cost", "check");
+
+    static const struct { const char *label; BarcodeFormat format; uint16_t w, h; } CASES[] = {
+        {"1D Code128 long", FORMAT_CODE128, 148, 10}, {"QR v5", FORMAT_QR, 37, 37},
+    };
+    for (unsigned i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        uint16_t w = CASES[i].w, h = CASES[i].h;
+        if (h > 10) make_2d(bits, w, h, 1);
+        else make_1d(bits, w, h);
+        barcode_draw(ctx, bounds, CASES[i].format, ENCODING_PACKED, w, h, bits, MAX_BITS_LEN, NULL);
+        uint32_t hash = fake_framebuffer_hash();
+        for (int y = 0; y < bounds.size.h; y++) {
+            for (int x = 0; x < bounds.size.w; x++) s_pixels[y][x] = fake_pixel_is_black(x, y);
+        }
+
+        bool ok = barcode_invert(ctx, bounds);
+        for (int y = 0; ok && y < bounds.size.h; y++) {
+            for (int x = 0; x < bounds.size.w; x++) {
+                if (fake_pixel_visible(x, y) && fake_pixel_is_black(x, y) == s_pixels[y][x]) ok = false;
+            }
+        }
+        ok = ok && barcode_invert(ctx, bounds) && fake_framebuffer_hash() == hash;
+
+        double t0 = now_us();
+        for (int k = 0; k < s_iterations; k++) {
+            barcode_draw(ctx, bounds, CASES[i].format, ENCODING_PACKED, w, h, bits, MAX_BITS_LEN, NULL);
+        }
+        double draw_us = (now_us() - t0) / s_iterations;
+        t0 = now_us();
+        for (int k = 0; k < s_iterations; k++) barcode_invert(ctx, bounds);
+        double invert_us = (now_us() - t0) / s_iterations;
+        printf("  %-22s %10.2f %10.2f %7.0f%%  %s\n", CASES[i].label, draw_us, invert_us,
+               100.0 * invert_us / draw_us, ok ? "ok" : "MISMATCH");
+    }
+}
+
+// --- Storage ---
+
+// Cards of one payload size that fit in the persist quota next to the fixed
+// records (settings, refs, usage) of a fresh install, index pages included
+static void bench_quota(void) {
+    static const int PAYLOADS[] = { 16, 32, 56, 128, 256, 968 };
+    static uint8_t bits[MAX_BITS_LEN];
+    memset(bits, '7', sizeof(bits));
+    printf("persist quota (%d bytes, MAX_CARDS %d)\n", FAKE_PERSIST_QUOTA, MAX_CARDS);
+    printf("  %-22s %8s %8s %8s %8s\n", "payload bytes", "cards", "fixed", "used", "per card");
+    for (int p = 0; p < (int)(sizeof(PAYLOADS) / sizeof(PAYLOADS[0])); p++) {
+        fake_persist_reset();
+        storage_load_settings();
+        storage_save_settings();
+        int fixed = fake_persist_used();
+        int n = 0;
+        while (n < MAX_CARDS) {
+            WalletCardInfo info = { .format = FORMAT_CODE128, .encoding = ENCODING_TEXT };
+            snprintf(info.name, sizeof(info.name), "Loyalty card %d", n);
+            if (!storage_save_card(n, &info, bits, PAYLOADS[p], 1000 + n)) break;
+            storage_save_count(++n);
+        }
+        storage_flush_index();
+        int used = fake_persist_used();
+        printf("  %-22d %8d %8d %8d %8d\n", PAYLOADS[p], n, fixed, used, n ? (used - fixed) / n : 0);
+    }
+}
+
+// A wallet in the 12-keys-per-card layout (STORAGE_VERSION 0) that leaves
+// almost no quota free: the migration has to make room card by card, and
+// every card must come out byte for byte or still be in the old layout.
+#define LEGACY_CARDS 10
+#define LEGACY_PAYLOAD 280
+
+static void bench_migrate(void) {
+    static uint8_t bits[MAX_BITS_LEN];
+    static uint8_t expect[LEGACY_CARDS][LEGACY_PAYLOAD];
+    fake_persist_reset();
+    for (int i = 0; i < LEGACY_CARDS; i++) {
+        int base_key = PERSIST_KEY_BASE + i * 12;
+        WalletCardInfo info = { .format = FORMAT_CODE128, .width = LEGACY_PAYLOAD * 8, .height = 1 };
+        snprintf(info.name, sizeof(info.name), "Old card %d", i);
+        persist_write_data(base_key, &info, sizeof(info));
+        for (int k = 0; k < LEGACY_PAYLOAD; k++) expect[i][k] = rng_next();
+        for (int off = 0, k = 1; off < LEGACY_PAYLOAD; off += 100, k++) {
+            int n = LEGACY_PAYLOAD - off < 100 ? LEGACY_PAYLOAD - off : 100;
+            persist_write_data(base_key + k, expect[i] + off, n);
+        }
+    }
+    persist_write_int(PERSIST_KEY_COUNT, LEGACY_CARDS);
+    int legacy_used = fake_persist_used();
+    fake_persist_set_quota(legacy_used + 16);
+
+    storage_load_settings();
+    int migrated = 0, kept = 0, lost = 0;
+    for (int i = 0; i < LEGACY_CARDS; i++) {
+        WalletCardInfo info;
+        char name[MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "Old card %d", i);
+        if (i < g_card_count && storage_load_card_info(i, &info) && strcmp(info.name, name) == 0 &&
+            storage_load_card_data(i, bits, MAX_BITS_LEN) == LEGACY_PAYLOAD &&
+            memcmp(bits, expect[i], LEGACY_PAYLOAD) == 0) {
+            migrated++;
+        } else if (persist_read_data(PERSIST_KEY_BASE + i * 12 + 1, bits, 100) == 100 &&
+                   memcmp(bits, expect[i], 100) == 0) {
+            kept++;
+        } else {
+            lost++;
+        }
+    }
+    bool ok = lost == 0 && migrated + kept == LEGACY_CARDS;
+    if (!ok) s_failures++;
+    printf("legacy migration (%d cards x %d bytes, %d of %d quota bytes)\n", LEGACY_CARDS, LEGACY_PAYLOAD,
+           legacy_used, legacy_used + 16);
+    printf("  %-22s %8s %8s %8s %8s  %s\n", "case", "migrated", "kept", "lost", "used", "check");
+    printf("  %-22s %8d %8d %8d %8d  %s\n", "nearly full quota", migrated, kept, lost, fake_persist_used(),
+           ok ? "ok" : "LOST");
+}
+
+static void bench_storage(void) {
+    static uint8_t bits[MAX_BITS_LEN];
+    fake_persist_reset();
+    storage_load_settings(); // Fresh install: stamps the storage version
+    storage_clear_all();
+    for (int i = 0; i < MAX_CARDS; i++) {
+        WalletCardInfo info = { .format = FORMAT_AZTEC, .width = 19, .height = 19 };
+        snprintf(info.name, sizeof(info.name), "Card %d", i);
+        make_2d(bits, 19, 19, 1);
+        storage_save_card(i, &info, bits, packed_len(19, 19), 1000 + i);
+        storage_save_count(i + 1);
+    }
+    storage_flush_index();
+
+    printf("storage (%d cards x %d bytes, %d of %d quota bytes)\n", MAX_CARDS, packed_len(19, 19),
+           fake_persist_used(), FAKE_PERSIST_QUOTA);
+    printf("  %-22s %10s %8s %8s %8s\n", "operation", "us/call", "reads", "writes", "exists");
+
+    fake_counters_reset();
+    double t0 = now_us();
+    storage_load_settings();
+    double us = now_us() - t0;
+    printf("  %-22s %10.2f %8u %8u %8u\n", "load_settings", us, g_fake_counters.persist_reads,
+           g_fake_counters.persist_writes, g_fake_counters.persist_exists);
+
+    fake_counters_reset();
+    t0 = now_us();
+    storage_load_card_data(MAX_CARDS / 2, bits, MAX_BITS_LEN);
+    us = now_us() - t0;
+    printf("  %-22s %10.2f %8u %8u %8u\n", "load_card_data", us, g_fake_counters.persist_reads,
+           g_fake_counters.persist_writes, g_fake_counters.persist_exists);
+
+    WalletCardInfo info;
+    fake_counters_reset();
+    t0 = now_us();
+    storage_load_card_info(0, &info);
+    us = now_us() - t0;
+    printf("  %-22s %10.2f %8u %8u %8u\n", "load_card_info", us, g_fake_counters.persist_reads,
+           g_fake_counters.persist_writes, g_fake_counters.persist_exists);
+
+    fake_counters_reset();
+    t0 = now_us();
+    storage_save_card(0, &info, bits, packed_len(19, 19), 1000);
+    us = now_us() - t0;
+    printf("  %-22s %10.2f %8u %8u %8u\n", "save_card", us, g_fake_counters.persist_reads,
+           g_fake_counters.persist_writes, g_fake_counters.persist_exists);
+
+    // Delta sync after the user reorders the wallet and edits one card: the
+    // manifest asks for that card only and no other card data is rewritten.
+    uint32_t hashes[MAX_CARDS];
+    uint8_t needed[(MAX_CARDS + 7) / 8];
+    for (int i = 0; i < MAX_CARDS; i++) hashes[i] = 1000 + (MAX_CARDS - 1 - i);
+    hashes[3] = 2000;
+    fake_counters_reset();
+    t0 = now_us();
+    int pending = storage_apply_manifest(hashes, MAX_CARDS, needed);
+    for (int i = 0; i < MAX_CARDS; i++) {
+        if (needed[i / 8] & (1 << (i % 8))) {
+            storage_load_card_info(i, &info);
+            storage_save_card(i, &info, bits, packed_len(19, 19), hashes[i]);
+        }
+    }
+    storage_flush_index();
+    us = now_us() - t0;
+    printf("  %-22s %10.2f %8u %8u %8u  (%d of %d cards sent)\n", "delta_sync", us,
+           g_fake_counters.persist_reads, g_fake_counters.persist_writes, g_fake_counters.persist_exists,
+           pending, MAX_CARDS);
+
+    // Menu scroll from a fresh launch: rows are paged in around the selection
+    storage_load_settings();
+    fake_counters_reset();
+    t0 = now_us();
+    for (int i = 0; i < MAX_CARDS; i++) storage_index_entry(i);
+    for (int i = MAX_CARDS - 1; i >= 0; i--) storage_index_entry(i);
+    us = now_us() - t0;
+    printf("  %-22s %10.2f %8u %8u %8u  (us per row; %d rows down and back up)\n", "menu_scroll", us / (2 * MAX_CARDS),
+           g_fake_counters.persist_reads, g_fake_counters.persist_writes, g_fake_counters.persist_exists,
+           2 * MAX_CARDS);
+}
+
+// --- Card Flipping ---
+// Detail window flow: open a card, then press DOWN repeatedly. Without
+// prefetch every flip misses the cache; with it the idle timer has already
+// loaded the next card. Expects bench_storage() to have saved the cards.
+
+static void bench_flip_case(const char *label, bool prefetch) {
+    card_cache_set_screen(fake_screen_bounds());
+    card_cache_clear();
+    int index = 0;
+    card_cache_get(index);
+
+    double total_us = 0;
+    uint32_t reads = 0;
+    int flips = MAX_CARDS * 2;
+    for (int i = 0; i < flips; i++) {
+        if (prefetch) {
+            card_cache_prefetch((index + 1) % MAX_CARDS);
+            card_cache_prefetch((index - 1 + MAX_CARDS) % MAX_CARDS);
+        }
+        index = (index + 1) % MAX_CARDS;
+        fake_counters_reset();
+        double t0 = now_us();
+        card_cache_get(index);
+        total_us += now_us() - t0;
+        reads += g_fake_counters.persist_reads;
+    }
+    printf("  %-22s %10.2f %8.1f\n", label, total_us / flips, (double)reads / flips);
+}
+
+static void bench_flip(void) {
+    printf("card flip (button press -> buffer ready)\n");
+    printf("  %-22s %10s %8s\n", "mode", "us/flip", "reads");
+    bench_flip_case("cold", false);
+    bench_flip_case("prefetched", true);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) s_iterations = atoi(argv[1]);
+    if (s_iterations < 1) s_iterations = 1;
+
+    GRect screen = fake_screen_bounds();
+    printf("== %s %dx%d (%d iterations) ==\n", BENCH_PLATFORM_NAME, screen.size.w, screen.size.h, s_iterations);
+    bench_render();
+#if WALLET_TEXT_ENCODERS
+    bench_qr();
+#endif
+    bench_invert();
+    bench_quota();
+    bench_migrate();
+    bench_storage();
+    bench_flip();
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,366 @@
+#include <pebble.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+// ============================================================================
+// Fake GContext and framebuffer
+// ============================================================================
+// aplite: 1-bit, LSB-first, 1 = white, rows padded to 32 bits.
+// basalt/chalk: one GColor8 byte per pixel; chalk only shows the pixels
+// inside the round display (same row spans the SDK reports).
+
+#define FB_W PBL_DISPLAY_WIDTH
+#define FB_H PBL_DISPLAY_HEIGHT
+#if defined(PBL_BW)
+  #define FB_STRIDE (((FB_W + 31) / 32) * 4)
+#else
+  #define FB_STRIDE FB_W
+#endif
+
+struct GBitmap {
+    uint8_t *data;
+};
+
+struct GContext {
+    GColor fill_color;
+    GColor text_color;
+    bool fb_captured;
+    GBitmap fb_bitmap;
+    uint8_t fb[FB_H * FB_STRIDE];
+};
+
+static GContext s_ctx;
+FakeCounters g_fake_counters;
+
+// Visible [min_x, max_x] for row y
+static void row_span(int y, int *min_x, int *max_x) {
+#if defined(PBL_ROUND)
+    // Pixel centres inside a circle of diameter FB_W: (2x+1-W)^2 + (2y+1-W)^2 <= W^2.
+    // Cached so the fake's own cost doesn't swamp the renderers being timed.
+    static int16_t s_half[FB_H];
+    static bool s_half_ready = false;
+    if (!s_half_ready) {
+        for (int row = 0; row < FB_H; row++) {
+            int dy = 2 * row + 1 - FB_W;
+            int half = 0;
+            while (true) {
+                int dx = 2 * half + 1;
+                if (dx * dx + dy * dy > FB_W * FB_W) break;
+                half++;
+            }
+            s_half[row] = half;
+        }
+        s_half_ready = true;
+    }
+    *min_x = FB_W / 2 - s_half[y];
+    *max_x = FB_W / 2 + s_half[y] - 1;
+#else
+    (void)y;
+    *min_x = 0;
+    *max_x = FB_W - 1;
+#endif
+}
+
+static void put_pixel(int x, int y, bool white) {
+#if defined(PBL_BW)
+    uint8_t *b = &s_ctx.fb[y * FB_STRIDE + x / 8];
+    if (white) *b |= (uint8_t)(1 << (x % 8));
+    else *b &= (uint8_t)~(1 << (x % 8));
+#else
+    s_ctx.fb[y * FB_STRIDE + x] = white ? GColorWhite.argb : GColorBlack.argb;
+#endif
+}
+
+GContext *fake_gcontext(void) {
+    return &s_ctx;
+}
+
+GRect fake_screen_bounds(void) {
+    return GRect(0, 0, FB_W, FB_H);
+}
+
+bool fake_pixel_visible(int x, int y) {
+    if (x < 0 || x >= FB_W || y < 0 || y >= FB_H) return false;
+    int min_x, max_x;
+    row_span(y, &min_x, &max_x);
+    return x >= min_x && x <= max_x;
+}
+
+bool fake_pixel_is_black(int x, int y) {
+    if (!fake_pixel_visible(x, y)) return false;
+#if defined(PBL_BW)
+    return !(s_ctx.fb[y * FB_STRIDE + x / 8] & (1 << (x % 8)));
+#else
+    return s_ctx.fb[y * FB_STRIDE + x] != GColorWhite.argb;
+#endif
+}
+
+// FNV-1a over the visible pixels, so renderer changes that alter output show up.
+uint32_t fake_framebuffer_hash(void) {
+    uint32_t h = 2166136261u;
+    for (int y = 0; y < FB_H; y++) {
+        for (int x = 0; x < FB_W; x++) {
+            h = (h ^ (fake_pixel_is_black(x, y) ? 1u : 0u)) * 16777619u;
+        }
+    }
+    return h;
+}
+
+void fake_counters_reset(void) {
+    memset(&g_fake_counters, 0, sizeof(g_fake_counters));
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+    ctx->fill_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+    ctx->text_color = color;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+    (void)corner_radius; (void)corner_mask;
+    if (ctx->fb_captured) {
+        fprintf(stderr, "fake gcontext: graphics_fill_rect while framebuffer is captured\n");
+        abort();
+    }
+    g_fake_counters.fill_rect_calls++;
+
+    int x0 = rect.origin.x, y0 = rect.origin.y;
+    int x1 = x0 + rect.size.w, y1 = y0 + rect.size.h;
+    if (y0 < 0) y0 = 0;
+    if (y1 > FB_H) y1 = FB_H;
+
+    bool white = (ctx->fill_color.argb == GColorWhite.argb);
+    for (int y = y0; y < y1; y++) {
+        int min_x, max_x;
+        row_span(y, &min_x, &max_x);
+        int rx0 = (x0 < min_x) ? min_x : x0;
+        int rx1 = (x1 > max_x + 1) ? max_x + 1 : x1;
+        if (rx0 >= rx1) continue;
+        g_fake_counters.pixels_touched += (uint32_t)(rx1 - rx0);
+        for (int x = rx0; x < rx1; x++) put_pixel(x, y, white);
+    }
+}
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+    if (ctx->fb_captured) return NULL;
+    g_fake_counters.fb_captures++;
+    ctx->fb_captured = true;
+    ctx->fb_bitmap.data = ctx->fb;
+    return &ctx->fb_bitmap;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+    if (!ctx->fb_captured || buffer != &ctx->fb_bitmap) return false;
+    ctx->fb_captured = false;
+    return true;
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+    return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+    (void)bitmap;
+    return FB_STRIDE;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+    (void)bitmap;
+    return GRect(0, 0, FB_W, FB_H);
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap) {
+    (void)bitmap;
+#if defined(PBL_BW)
+    return GBitmapFormat1Bit;
+#elif defined(PBL_ROUND)
+    return GBitmapFormat8BitCircular;
+#else
+    return GBitmapFormat8Bit;
+#endif
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y) {
+    int min_x, max_x;
+    row_span(y, &min_x, &max_x);
+    return (GBitmapDataRowInfo){ .data = bitmap->data + y * FB_STRIDE, .min_x = min_x, .max_x = max_x };
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment,
+                        GTextAttributes *attributes) {
+    (void)ctx; (void)text; (void)font; (void)box;
+    (void)overflow_mode; (void)alignment; (void)attributes;
+    g_fake_counters.text_calls++;
+}
+
+GFont fonts_get_system_font(const char *font_key) {
+    return font_key;
+}
+
+// ============================================================================
+// Fake persistent storage: open-addressed table, 256-byte values
+// ============================================================================
+// Writes are charged against a per-app quota like the watch's: the value
+// plus a per-key overhead for the stored key and record header. A write that
+// doesn't fit fails with E_OUT_OF_STORAGE and leaves the old value.
+
+#define PERSIST_SLOTS 2048
+#define PERSIST_KEY_OVERHEAD 12
+
+typedef struct {
+    bool used;
+    uint32_t key;
+    uint16_t len;
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistSlot;
+
+static PersistSlot s_persist[PERSIST_SLOTS];
+static int s_persist_used = 0;
+static int s_persist_quota = FAKE_PERSIST_QUOTA;
+
+static PersistSlot *persist_find(uint32_t key, bool create) {
+    uint32_t h = (key * 2654435761u) % PERSIST_SLOTS;
+    for (int probe = 0; probe < PERSIST_SLOTS; probe++) {
+        PersistSlot *s = &s_persist[(h + probe) % PERSIST_SLOTS];
+        if (s->used && s->key == key) return s;
+        if (!s->used) {
+            if (!create) return NULL;
+            s->used = true;
+            s->key = key;
+            s->len = 0;
+            return s;
+        }
+    }
+    fprintf(stderr, "fake persist: table full\n");
+    abort();
+}
+
+void fake_persist_reset(void) {
+    memset(s_persist, 0, sizeof(s_persist));
+    s_persist_used = 0;
+    s_persist_quota = FAKE_PERSIST_QUOTA;
+}
+
+void fake_persist_set_quota(int bytes) {
+    s_persist_quota = bytes;
+}
+
+int fake_persist_used(void) {
+    return s_persist_used;
+}
+
+int fake_persist_key_cost(uint32_t key) {
+    PersistSlot *s = persist_find(key, false);
+    return s ? PERSIST_KEY_OVERHEAD + s->len : 0;
+}
+
+bool persist_exists(uint32_t key) {
+    g_fake_counters.persist_exists++;
+    return persist_find(key, false) != NULL;
+}
+
+int persist_get_size(uint32_t key) {
+    PersistSlot *s = persist_find(key, false);
+    return s ? s->len : E_DOES_NOT_EXIST;
+}
+
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size) {
+    g_fake_counters.persist_reads++;
+    PersistSlot *s = persist_find(key, false);
+    if (!s) return E_DOES_NOT_EXIST;
+    size_t n = (s->len < buffer_size) ? s->len : buffer_size;
+    memcpy(buffer, s->data, n);
+    return (int)n;
+}
+
+int persist_write_data(uint32_t key, const void *data, size_t size) {
+    g_fake_counters.persist_writes++;
+    if (size > PERSIST_DATA_MAX_LENGTH) size = PERSIST_DATA_MAX_LENGTH;
+    int used = s_persist_used - fake_persist_key_cost(key) + PERSIST_KEY_OVERHEAD + (int)size;
+    if (used > s_persist_quota) return E_OUT_OF_STORAGE;
+    s_persist_used = used;
+    PersistSlot *s = persist_find(key, true);
+    memcpy(s->data, data, size);
+    s->len = (uint16_t)size;
+    return (int)size;
+}
+
+int32_t persist_read_int(uint32_t key) {
+    int32_t value = 0;
+    persist_read_data(key, &value, sizeof(value));
+    return value;
+}
+
+bool persist_read_bool(uint32_t key) {
+    return persist_read_int(key) != 0;
+}
+
+status_t persist_write_int(uint32_t key, int32_t value) {
+    int written = persist_write_data(key, &value, sizeof(value));
+    return (written < 0) ? written : S_SUCCESS;
+}
+
+status_t persist_write_bool(uint32_t key, bool value) {
+    return persist_write_int(key, value ? 1 : 0);
+}
+
+status_t persist_delete(uint32_t key) {
+    g_fake_counters.persist_writes++;
+    PersistSlot *s = persist_find(key, false);
+    if (!s) return E_DOES_NOT_EXIST;
+    s_persist_used -= PERSIST_KEY_OVERHEAD + s->len;
+    // Re-insert the rest of the probe chain so lookups stay correct.
+    s->used = false;
+    int idx = (int)(s - s_persist);
+    for (int probe = 1; probe < PERSIST_SLOTS; probe++) {
+        PersistSlot *n = &s_persist[(idx + probe) % PERSIST_SLOTS];
+        if (!n->used) break;
+        PersistSlot tmp = *n;
+        n->used = false;
+        PersistSlot *dst = persist_find(tmp.key, true);
+        *dst = tmp;
+    }
+    return S_SUCCESS;
+}
+
+// ============================================================================
+// Time
+// ============================================================================
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint16_t ms = ts.tv_nsec / 1000000;
+    if (tloc) *tloc = ts.tv_sec;
+    if (out_ms) *out_ms = ms;
+    return ms;
+}
+
+// ============================================================================
+// Heap
+// ============================================================================
+
+size_t heap_bytes_used(void) {
+    return 0;
+}
+
+size_t heap_bytes_free(void) {
+    return 0;
+}
+
+// ============================================================================
+// Logging
+// ============================================================================
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+    if (!getenv("BENCH_VERBOSE")) return;
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "[%d] %s:%d ", log_level, src_filename, src_line_number);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
@@ -0,0 +1,376 @@
+#include <pebble.h>
+
+// ============================================================================
+// Fake UI, timers and AppMessage (fuzz build)
+// ============================================================================
+// Just enough behaviour for main.c to run its real handlers on the host:
+// windows load when pushed and unload when destroyed, the top window's
+// layers draw into fake_gcontext(), timers fire in due order on a fake
+// clock, and inbox messages are built with fake_dict_* and delivered by hand.
+
+#define FAKE_MAX_CHILDREN 4
+#define FAKE_MAX_TIMERS 16
+#define FAKE_MAX_TUPLES 32
+#define FAKE_DICT_BYTES 4096
+#define FAKE_MAX_TIMER_FIRES 64 // Per fake_timers_run: timers that re-arm themselves stop here
+
+struct Layer {
+    GRect bounds;
+    LayerUpdateProc update_proc;
+    Layer *children[FAKE_MAX_CHILDREN];
+    int child_count;
+    MenuLayer *menu; // Set on a menu layer's own layer
+};
+
+struct MenuLayer {
+    Layer layer;
+    MenuLayerCallbacks callbacks;
+    void *context;
+    MenuIndex selected;
+};
+
+struct Window {
+    WindowHandlers handlers;
+    ClickConfigProvider click_provider;
+    ClickHandler clicks[NUM_BUTTONS];
+    Layer root;
+    bool loaded;
+};
+
+struct AppTimer {
+    bool used;
+    uint64_t due_ms;
+    AppTimerCallback callback;
+    void *data;
+};
+
+struct DictionaryIterator {
+    Tuple *tuples[FAKE_MAX_TUPLES];
+    int count;
+    uint16_t used;
+    uint8_t buffer[FAKE_DICT_BYTES];
+};
+
+static Window *s_stack[8];
+static int s_stack_depth = 0;
+static Window *s_configuring = NULL; // Window whose click provider is running
+static AppTimer s_timers[FAKE_MAX_TIMERS];
+static uint64_t s_now_ms = 0;
+static AppMessageInboxReceived s_inbox = NULL;
+static AppLaunchReason s_launch_reason = APP_LAUNCH_USER;
+static DictionaryIterator s_inbox_dict;
+static DictionaryIterator s_outbox_dict;
+
+void fake_ui_reset(void) {
+    s_launch_reason = APP_LAUNCH_USER;
+    s_stack_depth = 0;
+    s_configuring = NULL;
+    memset(s_timers, 0, sizeof(s_timers));
+    s_now_ms = 0;
+    s_inbox = NULL;
+}
+
+// --- Windows and layers ---
+
+Window *window_create(void) {
+    Window *w = calloc(1, sizeof(Window));
+    if (w) w->root.bounds = fake_screen_bounds();
+    return w;
+}
+
+void window_destroy(Window *window) {
+    if (!window) return;
+    if (window->loaded && window->handlers.unload) window->handlers.unload(window);
+    for (int i = 0; i < s_stack_depth; i++) {
+        if (s_stack[i] == window) {
+            memmove(&s_stack[i], &s_stack[i + 1], (s_stack_depth - i - 1) * sizeof(Window *));
+            s_stack_depth--;
+            break;
+        }
+    }
+    free(window);
+}
+
+Layer *window_get_root_layer(const Window *window) {
+    return (Layer *)&window->root;
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+    window->handlers = handlers;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider provider) {
+    window->click_provider = provider;
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+    if (s_configuring && button_id < NUM_BUTTONS) s_configuring->clicks[button_id] = handler;
+}
+
+void window_stack_push(Window *window, bool animated) {
+    (void)animated;
+    if (s_stack_depth > 0 && s_stack[s_stack_depth - 1] == window) return;
+    if (s_stack_depth == (int)(sizeof(s_stack) / sizeof(s_stack[0]))) return;
+    s_stack[s_stack_depth++] = window;
+    if (!window->loaded) {
+        window->loaded = true;
+        if (window->handlers.load) window->handlers.load(window);
+    }
+    if (window->click_provider) {
+        s_configuring = window;
+        window->click_provider(NULL);
+        s_configuring = NULL;
+    }
+}
+
+ButtonId click_recognizer_get_button_id(ClickRecognizerRef recognizer) {
+    return (ButtonId)(uintptr_t)recognizer;
+}
+
+Layer *layer_create(GRect frame) {
+    Layer *l = calloc(1, sizeof(Layer));
+    if (l) l->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+    return l;
+}
+
+void layer_destroy(Layer *layer) {
+    free(layer);
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+    return layer->bounds;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+    layer->update_proc = update_proc;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+    if (parent->child_count < FAKE_MAX_CHILDREN) parent->children[parent->child_count++] = child;
+}
+
+void layer_mark_dirty(Layer *layer) {
+    (void)layer;
+}
+
+// --- Menu ---
+
+MenuLayer *menu_layer_create(GRect frame) {
+    MenuLayer *m = calloc(1, sizeof(MenuLayer));
+    if (!m) return NULL;
+    m->layer.bounds = GRect(0, 0, frame.size.w, frame.size.h);
+    m->layer.menu = m;
+    return m;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+    free(menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+    return (Layer *)&menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+    menu_layer->callbacks = callbacks;
+    menu_layer->context = callback_context;
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window) {
+    (void)menu_layer; (void)window;
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+    (void)menu_layer;
+}
+
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index, MenuRowAlign scroll_align, bool animated) {
+    (void)scroll_align; (void)animated;
+    menu_layer->selected = index;
+}
+
+// Reads both strings to their terminator, as the SDK's text layout would
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle,
+                          GBitmap *icon) {
+    (void)cell_layer; (void)icon;
+    graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), GRect(0, 0, 144, 24),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    if (subtitle && strlen(subtitle) > 0) {
+        graphics_draw_text(ctx, subtitle, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), GRect(0, 24, 144, 24),
+                           GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    }
+}
+
+static void render_menu(MenuLayer *m, GContext *ctx) {
+    if (!m->callbacks.get_num_rows || !m->callbacks.draw_row) return;
+    uint16_t rows = m->callbacks.get_num_rows(m, 0, m->context);
+    Layer cell = { .bounds = GRect(0, 0, m->layer.bounds.size.w, 44) };
+    for (uint16_t r = 0; r < rows; r++) {
+        MenuIndex index = { 0, r };
+        if (m->callbacks.get_cell_height) cell.bounds.size.h = m->callbacks.get_cell_height(m, &index, m->context);
+        m->callbacks.draw_row(ctx, &cell, &index, m->context);
+    }
+}
+
+static void render_layer(Layer *layer, GContext *ctx) {
+    if (layer->menu) render_menu(layer->menu, ctx);
+    if (layer->update_proc) layer->update_proc(layer, ctx);
+    for (int i = 0; i < layer->child_count; i++) render_layer(layer->children[i], ctx);
+}
+
+void fake_ui_render(void) {
+    if (s_stack_depth == 0) return;
+    render_layer(&s_stack[s_stack_depth - 1]->root, fake_gcontext());
+}
+
+// SELECT on the menu opens the selected row; UP/DOWN go to the top window
+void fake_ui_click(ButtonId button) {
+    if (s_stack_depth == 0 || button >= NUM_BUTTONS) return;
+    Window *top = s_stack[s_stack_depth - 1];
+    if (button == BUTTON_ID_SELECT) {
+        Layer *root = &top->root;
+        for (int i = 0; i < root->child_count; i++) {
+            MenuLayer *m = root->children[i]->menu;
+            if (m && m->callbacks.select_click) m->callbacks.select_click(m, &m->selected, m->context);
+        }
+        return;
+    }
+    if (top->clicks[button]) top->clicks[button]((ClickRecognizerRef)(uintptr_t)button, NULL);
+}
+
+void light_enable(bool enable) {
+    (void)enable;
+}
+
+void fake_ui_set_launch_reason(AppLaunchReason reason) {
+    s_launch_reason = reason;
+}
+
+AppLaunchReason launch_reason(void) {
+    return s_launch_reason;
+}
+
+void app_event_loop(void) {
+}
+
+// --- Timers ---
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+    for (int i = 0; i < FAKE_MAX_TIMERS; i++) {
+        AppTimer *t = &s_timers[i];
+        if (t->used) continue;
+        *t = (AppTimer){ .used = true, .due_ms = s_now_ms + timeout_ms, .callback = callback, .data = callback_data };
+        return t;
+    }
+    return NULL;
+}
+
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms) {
+    if (!timer || !timer->used) return false;
+    timer->due_ms = s_now_ms + new_timeout_ms;
+    return true;
+}
+
+void app_timer_cancel(AppTimer *timer) {
+    if (timer) timer->used = false;
+}
+
+int fake_timers_run(void) {
+    int fired = 0;
+    while (fired < FAKE_MAX_TIMER_FIRES) {
+        AppTimer *next = NULL;
+        for (int i = 0; i < FAKE_MAX_TIMERS; i++) {
+            if (s_timers[i].used && (!next || s_timers[i].due_ms < next->due_ms)) next = &s_timers[i];
+        }
+        if (!next) break;
+        s_now_ms = next->due_ms;
+        next->used = false;
+        next->callback(next->data);
+        fired++;
+    }
+    return fired;
+}
+
+// --- AppMessage ---
+
+DictionaryIterator *fake_dict_begin(void) {
+    s_inbox_dict.count = 0;
+    s_inbox_dict.used = 0;
+    return &s_inbox_dict;
+}
+
+static Tuple *dict_add(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data, uint16_t len) {
+    uint16_t size = sizeof(Tuple) + len;
+    if (iter->count == FAKE_MAX_TUPLES || iter->used + size > FAKE_DICT_BYTES) return NULL;
+    Tuple *t = (Tuple *)(iter->buffer + iter->used);
+    t->key = key;
+    t->type = type;
+    t->length = len;
+    if (len) memcpy(t->value->data, data, len);
+    iter->used += size;
+    iter->tuples[iter->count++] = t;
+    return t;
+}
+
+void fake_dict_add_int(DictionaryIterator *iter, uint32_t key, int32_t value) {
+    dict_add(iter, key, TUPLE_INT, &value, sizeof(value));
+}
+
+void fake_dict_add_data(DictionaryIterator *iter, uint32_t key, const uint8_t *data, uint16_t len) {
+    dict_add(iter, key, TUPLE_BYTE_ARRAY, data, len);
+}
+
+// `len` bytes of `str`, terminated like the SDK's cstrings
+void fake_dict_add_cstring(DictionaryIterator *iter, uint32_t key, const char *str, uint16_t len) {
+    Tuple *t = dict_add(iter, key, TUPLE_CSTRING, str, len + 1);
+    if (t) ((char *)t->value)[len] = '\0';
+}
+
+void fake_app_message_deliver(DictionaryIterator *iter) {
+    if (s_inbox) s_inbox(iter, NULL);
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+    for (int i = 0; i < iter->count; i++) {
+        if (iter->tuples[i]->key == key) return iter->tuples[i];
+    }
+    return NULL;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *data, const uint16_t size) {
+    return dict_add(iter, key, TUPLE_BYTE_ARRAY, data, size) ? DICT_OK : DICT_NOT_ENOUGH_STORAGE;
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+    return dict_add(iter, key, TUPLE_UINT, &value, 1) ? DICT_OK : DICT_NOT_ENOUGH_STORAGE;
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+    return dict_add(iter, key, TUPLE_UINT, &value, 4) ? DICT_OK : DICT_NOT_ENOUGH_STORAGE;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+    (void)size_inbound; (void)size_outbound;
+    return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+    return 8200;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+    AppMessageInboxReceived previous = s_inbox;
+    s_inbox = received_callback;
+    return previous;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+    s_outbox_dict.count = 0;
+    s_outbox_dict.used = 0;
+    *iterator = &s_outbox_dict;
+    return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+    return APP_MSG_OK;
+}
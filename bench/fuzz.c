@@ -0,0 +1,551 @@
+// ============================================================================
+// Renderer and sync fuzzer with a latency budget
+// ============================================================================
+// Two targets behind one input format (first byte even: render, odd: inbox):
+//
+// - render: a (format, encoding, width, height, flags) header and the card
+//   bytes, drawn like the detail window draws a cached card: edge table,
+//   barcode_draw, optionally a display list compiled and replayed, and the
+//   invert pass, on the full screen or an inset layer. The bytes sit in an exact-size heap block, so a renderer
+//   that trusts width*height over the buffer is an ASan report.
+// - inbox: AppMessage dictionaries fed to main.c's inbox_received_handler
+//   (main.c is compiled into this file), then the menu and the detail window
+//   drawn from what was stored, flipping through the cards, then a relaunch
+//   on the stored cards (menu order, quick launch).
+//
+// Every input is scored by graphics_fill_rect calls, pixels filled and wall
+// time per frame; the worst inputs per score are kept and can be saved as
+// the corpus. An input over the budget fails the run.
+//
+// Standalone (gcc, no libFuzzer):
+//   fuzz_<platform> [-runs N] [-seed S] [-save DIR] [corpus files or dirs...]
+// replays the corpus, then N generated inputs. Built with
+// -DFUZZ_LIBFUZZER it is a libFuzzer target instead (clang -fsanitize=fuzzer);
+// a budget overrun aborts so libFuzzer keeps the input.
+
+#include "common.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// main.c's main() falls off the end, which only main() may do
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main wallet_main
+#include "main.c"
+#undef main
+#pragma GCC diagnostic pop
+
+// --- Budget ---
+// Per drawn frame: what the screen can show, whatever the card claims.
+// fill_rect calls stand in for watch time off the framebuffer path; a
+// checkerboard at one pixel per module is the most the screen holds. Wall
+// time is only checked in the latency build (-DFUZZ_CHECK_TIME, no
+// sanitizers), re-measured before it counts.
+#define SCREEN_PIXELS (PBL_DISPLAY_WIDTH * PBL_DISPLAY_HEIGHT)
+#define BUDGET_FILL_RECTS (SCREEN_PIXELS / 2)
+#define BUDGET_PIXELS (SCREEN_PIXELS * 3) // Background, bars, display list replay
+#define BUDGET_FRAME_US 1500.0    // Host time; real cards draw in 4-50 us on the bench
+#define BUDGET_MESSAGE_US 10000.0 // One inbox message, display list compile included
+
+#define FUZZ_MAX_INPUT 4096
+#define FUZZ_MAX_FRAMES 6
+
+enum { TARGET_RENDER, TARGET_INBOX };
+// FLAG_INSET draws into a layer smaller than the screen, which takes the
+// fill_rect renderers instead of the framebuffer blitter
+enum { FLAG_EDGES = 1, FLAG_INVERT = 2, FLAG_DISPLAY_LIST = 4, FLAG_INSET = 8 };
+
+typedef struct {
+    uint32_t fill_rects;
+    uint32_t pixels;
+    double frame_us;
+    double message_us;
+} Score;
+
+// --- Measuring ---
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void score_frame(Score *s, double us) {
+    if (g_fake_counters.fill_rect_calls > s->fill_rects) s->fill_rects = g_fake_counters.fill_rect_calls;
+    if (g_fake_counters.pixels_touched > s->pixels) s->pixels = g_fake_counters.pixels_touched;
+    if (us > s->frame_us) s->frame_us = us;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+// --- Render target ---
+
+static void run_render(const uint8_t *data, size_t size, Score *score) {
+    if (size < 8) return;
+    BarcodeFormat format = (BarcodeFormat)(data[1] % 8);
+    CardEncoding encoding = (CardEncoding)(data[2] % 3);
+    uint16_t w = get16(data + 3), h = get16(data + 5);
+    uint8_t flags = data[7];
+    size_t len = size - 8;
+    if (len > MAX_BITS_LEN) len = MAX_BITS_LEN; // What the card cache holds at most
+
+    uint8_t *bits = len ? malloc(len) : NULL;
+    if (len && !bits) return;
+    if (len) memcpy(bits, data + 8, len);
+
+    GContext *ctx = fake_gcontext();
+    GRect bounds = fake_screen_bounds();
+    if (flags & FLAG_INSET) bounds.size = GSize(bounds.size.w - 8, bounds.size.h - 8);
+    static ModuleEdges edges;
+
+    fake_counters_reset();
+    double t0 = now_us();
+    edges.modules = 0;
+    if ((flags & FLAG_EDGES) && bits) barcode_build_edges(bounds, format, encoding, w, h, bits, len, &edges);
+    barcode_draw(ctx, bounds, format, encoding, w, h, bits, len, (flags & FLAG_EDGES) ? &edges : NULL);
+    if (flags & FLAG_INVERT) barcode_invert(ctx, bounds);
+    score_frame(score, now_us() - t0);
+
+#if WALLET_DISPLAY_LISTS
+    if ((flags & FLAG_DISPLAY_LIST) && bits) {
+        static uint8_t dlist[DLIST_MAX_LEN];
+        int dlist_len = barcode_compile_display_list(bounds, format, encoding, w, h, bits, len, dlist, sizeof(dlist));
+        fake_counters_reset();
+        t0 = now_us();
+        if (!barcode_draw_display_list(ctx, bounds, dlist, dlist_len)) {
+            barcode_draw(ctx, bounds, format, encoding, w, h, bits, len, NULL);
+        }
+        score_frame(score, now_us() - t0);
+    }
+#endif
+    free(bits);
+}
+
+// --- Inbox target ---
+// After the first byte, a stream of tuples: a control byte 0xFF delivers the
+// message built so far, anything else picks a message key (c % key count)
+// and a type ((c / key count) % 3): int (4 bytes), data (2-byte length) or
+// cstring (1-byte length). The last message is delivered at the end.
+
+// A fresh launch; storage is kept unless `wipe`
+static void app_reset(bool wipe) {
+    if (wipe) fake_persist_reset();
+    fake_ui_reset();
+    card_cache_clear();
+    g_card_count = 0;
+    g_active_card = NULL;
+    g_invert_colors = g_sort_by_use = false;
+    g_quick_launch = QUICK_LAUNCH_OFF;
+    s_main_window = s_detail_window = NULL;
+    s_menu_layer = NULL;
+    s_barcode_layer = NULL;
+    s_current_index = s_current_row = 0;
+    s_loading = true;
+    s_prefetch_timer = s_index_flush_timer = NULL;
+    s_prefetch_step = 0;
+}
+
+static void run_frames(int frames, Score *score) {
+    for (int frame = 0; frame < frames; frame++) {
+        if (frame == 1) fake_ui_click(BUTTON_ID_SELECT);
+        else if (frame > 1) fake_ui_click(BUTTON_ID_DOWN);
+        fake_counters_reset();
+        double t0 = now_us();
+        fake_ui_render();
+        score_frame(score, now_us() - t0);
+        fake_timers_run(); // Prefetch
+    }
+}
+
+static void deliver(DictionaryIterator *iter, Score *score) {
+    double t0 = now_us();
+    fake_app_message_deliver(iter);
+    double us = now_us() - t0;
+    if (us > score->message_us) score->message_us = us;
+}
+
+static void run_inbox(const uint8_t *data, size_t size, Score *score) {
+    app_reset(true);
+    init();
+    fake_timers_run(); // Startup request and loading timeout
+
+    DictionaryIterator *iter = fake_dict_begin();
+    bool pending = false;
+    size_t i = 1;
+    while (i < size) {
+        uint8_t c = data[i++];
+        if (c == 0xFF) {
+            deliver(iter, score);
+            iter = fake_dict_begin();
+            pending = false;
+            continue;
+        }
+        uint32_t key = MESSAGE_KEY_CMD_SYNC_START + c % MESSAGE_KEY_COUNT_;
+        switch ((c / MESSAGE_KEY_COUNT_) % 3) {
+            case 0: {
+                if (i + 4 > size) { i = size; break; }
+                int32_t v = (int32_t)(data[i] | (data[i + 1] << 8) | (data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24));
+                fake_dict_add_int(iter, key, v);
+                i += 4;
+                break;
+            }
+            case 1: {
+                if (i + 2 > size) { i = size; break; }
+                uint16_t n = get16(data + i);
+                i += 2;
+                if (n > size - i) n = size - i;
+                fake_dict_add_data(iter, key, data + i, n);
+                i += n;
+                break;
+            }
+            default: {
+                if (i + 1 > size) { i = size; break; }
+                uint16_t n = data[i++];
+                if (n > size - i) n = size - i;
+                fake_dict_add_cstring(iter, key, (const char *)data + i, n);
+                i += n;
+                break;
+            }
+        }
+        pending = true;
+    }
+    if (pending) deliver(iter, score);
+    fake_timers_run(); // Index flush
+
+    // Menu, then the detail window flipping through the cards
+    run_frames(FUZZ_MAX_FRAMES, score);
+    deinit();
+
+    // Relaunch on what was stored, from a Quick Launch button when bit 1 of
+    // the first byte is set: menu order and quick launch from the usage
+    // recorded above
+    app_reset(false);
+    fake_ui_set_launch_reason((data[0] & 2) ? APP_LAUNCH_QUICK_LAUNCH : APP_LAUNCH_USER);
+    init();
+    run_frames(2, score);
+    deinit();
+    s_main_window = s_detail_window = NULL;
+}
+
+static void run_input(const uint8_t *data, size_t size, Score *score) {
+    memset(score, 0, sizeof(*score));
+    if (size == 0) return;
+    if (data[0] % 2 == TARGET_RENDER) run_render(data, size, score);
+    else run_inbox(data, size, score);
+}
+
+static bool over_budget(const Score *s, bool check_time) {
+    if (s->fill_rects > BUDGET_FILL_RECTS || s->pixels > BUDGET_PIXELS) return true;
+    return check_time && (s->frame_us > BUDGET_FRAME_US || s->message_us > BUDGET_MESSAGE_US);
+}
+
+#if defined(FUZZ_LIBFUZZER)
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    Score score;
+    run_input(data, size, &score);
+    if (over_budget(&score, false)) abort();
+    return 0;
+}
+
+#else
+
+// --- Standalone driver ---
+
+#if defined(FUZZ_CHECK_TIME)
+static const bool s_check_time = true;
+#else
+static const bool s_check_time = false;
+#endif
+
+static uint32_t s_rng = 0x2545F491;
+
+static uint32_t rng_next(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static uint32_t rng_below(uint32_t n) {
+    return n ? rng_next() % n : 0;
+}
+
+// Sizes around the edges the renderers care about
+static uint16_t pick_dimension(void) {
+    static const uint16_t EDGES[] = {0, 1, 2, 3, 10, 21, 57, 95, 144, 145, 168, 180, 181, 320, 321, 1000, 8000, 65535};
+    switch (rng_below(3)) {
+        case 0: return EDGES[rng_below(sizeof(EDGES) / sizeof(EDGES[0]))];
+        case 1: return 1 + rng_below(200);
+        default: return rng_next();
+    }
+}
+
+static size_t put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return 2;
+}
+
+static void fill_payload(uint8_t *p, size_t n) {
+    static const uint8_t PATTERNS[] = {0x00, 0xFF, 0xAA, 0x55, 0x80, 0x01, 0xCC};
+    int mode = rng_below(4);
+    uint8_t pattern = PATTERNS[rng_below(sizeof(PATTERNS))];
+    for (size_t i = 0; i < n; i++) {
+        switch (mode) {
+            case 0: p[i] = rng_next(); break;
+            case 1: p[i] = pattern; break;
+            case 2: p[i] = (i % 2) ? pattern : (uint8_t)~pattern; break;
+            default: p[i] = 32 + rng_below(95); break; // Text
+        }
+    }
+}
+
+static size_t gen_render(uint8_t *buf) {
+    uint16_t w = pick_dimension(), h = pick_dimension();
+    if (rng_below(3) == 0) h = 1 + rng_below(12); // 1D-like
+    buf[0] = TARGET_RENDER;
+    buf[1] = rng_below(8);
+    buf[2] = rng_below(3);
+    put16(buf + 3, w);
+    put16(buf + 5, h);
+    buf[7] = rng_below(16);
+    size_t len;
+    switch (rng_below(4)) {
+        case 0: len = ((uint32_t)w * h + 7) / 8; break;
+        case 1: len = rng_below(64); break;
+        case 2: len = MAX_BITS_LEN; break;
+        default: len = rng_below(MAX_BITS_LEN + 1); break;
+    }
+    if (len > MAX_BITS_LEN) len = MAX_BITS_LEN;
+    fill_payload(buf + 8, len);
+    return 8 + len;
+}
+
+static size_t add_int(uint8_t *p, int key, int32_t v) {
+    p[0] = key - MESSAGE_KEY_CMD_SYNC_START;
+    memcpy(p + 1, &v, 4);
+    return 5;
+}
+
+static size_t add_data_header(uint8_t *p, int key, uint16_t n) {
+    p[0] = (key - MESSAGE_KEY_CMD_SYNC_START) + MESSAGE_KEY_COUNT_;
+    return 1 + put16(p + 1, n);
+}
+
+static size_t add_cstring(uint8_t *p, int key, const char *s, uint8_t n) {
+    p[0] = (key - MESSAGE_KEY_CMD_SYNC_START) + 2 * MESSAGE_KEY_COUNT_;
+    p[1] = n;
+    for (int i = 0; i < n; i++) p[2 + i] = s[i % (strlen(s) ? strlen(s) : 1)];
+    return 2 + n;
+}
+
+// A sync: start or manifest, then cards (some chunked), then complete and
+// sometimes a late "up to date" reply, with fields and lengths pushed to
+// their edges now and then
+static size_t gen_inbox(uint8_t *buf, size_t cap) {
+    size_t n = 0;
+    buf[n++] = TARGET_INBOX | (rng_below(2) << 1);
+    if (rng_below(3)) n += add_int(buf + n, MESSAGE_KEY_CMD_SYNC_START, 1);
+    else {
+        uint16_t count = rng_below(MAX_CARDS + 3);
+        n += add_data_header(buf + n, MESSAGE_KEY_CMD_SYNC_MANIFEST, count * 4);
+        fill_payload(buf + n, count * 4);
+        n += count * 4;
+    }
+    n += add_int(buf + n, MESSAGE_KEY_KEY_INVERT, rng_below(2));
+    n += add_int(buf + n, MESSAGE_KEY_KEY_SORT, rng_below(2));
+    n += add_int(buf + n, MESSAGE_KEY_KEY_QUICK_LAUNCH, rng_below(4) ? (int)rng_below(3) : (int32_t)rng_next());
+    buf[n++] = 0xFF;
+
+    int cards = 1 + rng_below(MAX_CARDS + 1);
+    for (int c = 0; c < cards && n + MAX_BITS_LEN + 300 < cap; c++) {
+        int format = rng_below(8);
+        int encoding = rng_below(3);
+        uint16_t w = (encoding == ENCODING_TEXT) ? 0 : pick_dimension();
+        uint16_t h = (encoding == ENCODING_TEXT) ? 0 : (rng_below(2) ? 1 + rng_below(12) : pick_dimension());
+        uint16_t len = rng_below(3) ? rng_below(MAX_BITS_LEN + 1) : (uint16_t)(((uint32_t)w * h + 7) / 8);
+        if (len > MAX_BITS_LEN + 8) len = MAX_BITS_LEN + 8;
+        bool chunked = rng_below(3) == 0;
+
+        n += add_int(buf + n, MESSAGE_KEY_KEY_INDEX, rng_below(4) ? c : (int)rng_below(MAX_CARDS + 2) - 1);
+        n += add_cstring(buf + n, MESSAGE_KEY_KEY_NAME, "Card name that runs long", rng_below(3) ? 8 : 60);
+        n += add_cstring(buf + n, MESSAGE_KEY_KEY_DESCRIPTION, "Desc", rng_below(40));
+        n += add_int(buf + n, MESSAGE_KEY_KEY_FORMAT, rng_below(8) ? format : (int32_t)rng_next());
+        n += add_int(buf + n, MESSAGE_KEY_KEY_WIDTH, w);
+        n += add_int(buf + n, MESSAGE_KEY_KEY_HEIGHT, h);
+        n += add_int(buf + n, MESSAGE_KEY_KEY_ENCODING, encoding);
+        n += add_int(buf + n, MESSAGE_KEY_KEY_HASH, rng_next());
+        if (!chunked) {
+            n += add_data_header(buf + n, MESSAGE_KEY_KEY_DATA, len);
+            fill_payload(buf + n, len);
+            n += len;
+            buf[n++] = 0xFF;
+            continue;
+        }
+        uint16_t chunk = 1 + rng_below(rng_below(2) ? 400 : 40);
+        n += add_int(buf + n, MESSAGE_KEY_KEY_DATA_LEN, len);
+        n += add_int(buf + n, MESSAGE_KEY_KEY_CHUNK_SIZE, chunk);
+        buf[n++] = 0xFF;
+        for (int seq = 0; seq * chunk < len && n + chunk + 16 < cap; seq++) {
+            int s = rng_below(8) ? seq : (int)rng_below(40) - 2; // Sometimes out of range
+            uint16_t piece = (len - seq * chunk < chunk) ? len - seq * chunk : chunk;
+            n += add_int(buf + n, MESSAGE_KEY_KEY_INDEX, c);
+            n += add_int(buf + n, MESSAGE_KEY_KEY_SEQ, s);
+            n += add_data_header(buf + n, MESSAGE_KEY_CMD_SYNC_DATA, piece);
+            fill_payload(buf + n, piece);
+            n += piece;
+            buf[n++] = 0xFF;
+        }
+    }
+    if (n + 5 <= cap) n += add_int(buf + n, MESSAGE_KEY_CMD_SYNC_COMPLETE, 1);
+    if (!rng_below(4) && n + 6 <= cap) {
+        buf[n++] = 0xFF;
+        n += add_int(buf + n, MESSAGE_KEY_CMD_SYNC_UP_TO_DATE, 1);
+    }
+    return n;
+}
+
+// --- Worst inputs ---
+
+typedef struct {
+    const char *name;
+    double value;
+    uint8_t data[FUZZ_MAX_INPUT];
+    size_t size;
+} Worst;
+
+static Worst s_worst[] = {
+    {.name = "render-fill-rects"}, {.name = "render-pixels"}, {.name = "render-frame-us"},
+    {.name = "inbox-frame-us"}, {.name = "inbox-message-us"},
+};
+
+static void keep_worst(Worst *w, double value, const uint8_t *data, size_t size) {
+    if (value <= w->value) return;
+    w->value = value;
+    memcpy(w->data, data, size);
+    w->size = size;
+}
+
+static void record(const uint8_t *data, size_t size, const Score *s) {
+    if (data[0] % 2 == TARGET_RENDER) {
+        keep_worst(&s_worst[0], s->fill_rects, data, size);
+        keep_worst(&s_worst[1], s->pixels, data, size);
+        keep_worst(&s_worst[2], s->frame_us, data, size);
+    } else {
+        keep_worst(&s_worst[3], s->frame_us, data, size);
+        keep_worst(&s_worst[4], s->message_us, data, size);
+    }
+}
+
+static int s_failures = 0;
+
+static bool beats_worst_time(const uint8_t *data, const Score *s) {
+    if (data[0] % 2 == TARGET_RENDER) return s->frame_us > s_worst[2].value;
+    return s->frame_us > s_worst[3].value || s->message_us > s_worst[4].value;
+}
+
+// Time is noisy: an input over the time budget, or slower than the worst so
+// far, gets the best of 5 runs
+static void check(const char *label, const uint8_t *data, size_t size) {
+    Score s;
+    run_input(data, size, &s);
+    if (beats_worst_time(data, &s) || (s_check_time && over_budget(&s, true))) {
+        for (int k = 0; k < 4; k++) {
+            Score again;
+            run_input(data, size, &again);
+            if (again.frame_us < s.frame_us) s.frame_us = again.frame_us;
+            if (again.message_us < s.message_us) s.message_us = again.message_us;
+        }
+    }
+    record(data, size, &s);
+    if (over_budget(&s, s_check_time)) {
+        s_failures++;
+        printf("  OVER BUDGET %s: %u fill_rects, %u pixels, %.0f us/frame, %.0f us/message\n",
+               label, s.fill_rects, s.pixels, s.frame_us, s.message_us);
+        if (data[0] % 2 == TARGET_RENDER && size >= 8) {
+            printf("    render format %d encoding %d, %ux%u, flags %d, %zu bytes\n",
+                   data[1] % 8, data[2] % 3, get16(data + 3), get16(data + 5), data[7], size - 8);
+        }
+    }
+}
+
+static void replay_file(const char *path) {
+    static uint8_t buf[FUZZ_MAX_INPUT];
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+    size_t size = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    check(path, buf, size);
+}
+
+static int replay_path(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    if (!S_ISDIR(st.st_mode)) {
+        replay_file(path);
+        return 1;
+    }
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+    int count = 0;
+    struct dirent *e;
+    while ((e = readdir(dir))) {
+        if (e->d_name[0] == '.') continue;
+        char file[512];
+        snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+        replay_file(file);
+        count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+static void save_worst(const char *dir) {
+    for (unsigned i = 0; i < sizeof(s_worst) / sizeof(s_worst[0]); i++) {
+        if (!s_worst[i].size) continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s-%s.bin", dir, BENCH_PLATFORM_NAME, s_worst[i].name);
+        FILE *f = fopen(path, "wb");
+        if (!f) continue;
+        fwrite(s_worst[i].data, 1, s_worst[i].size, f);
+        fclose(f);
+    }
+}
+
+int main(int argc, char **argv) {
+    int runs = 2000;
+    const char *save_dir = NULL;
+    int replayed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-runs") && i + 1 < argc) runs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-seed") && i + 1 < argc) s_rng = strtoul(argv[++i], NULL, 0) | 1;
+        else if (!strcmp(argv[i], "-save") && i + 1 < argc) save_dir = argv[++i];
+        else replayed += replay_path(argv[i]);
+    }
+
+    static uint8_t buf[FUZZ_MAX_INPUT];
+    for (int r = 0; r < runs; r++) {
+        size_t size = (r % 2 == 0) ? gen_render(buf) : gen_inbox(buf, sizeof(buf));
+        char label[32];
+        snprintf(label, sizeof(label), "generated #%d", r);
+        check(label, buf, size);
+    }
+
+    printf("== fuzz %s: %d corpus + %d generated inputs%s ==\n", BENCH_PLATFORM_NAME, replayed, runs,
+           s_check_time ? ", time budget checked" : "");
+    printf("  %-22s %12s %12s\n", "worst", "value", "budget");
+    static const double BUDGETS[] = {BUDGET_FILL_RECTS, BUDGET_PIXELS, BUDGET_FRAME_US,
+                                     BUDGET_FRAME_US, BUDGET_MESSAGE_US};
+    for (unsigned i = 0; i < sizeof(s_worst) / sizeof(s_worst[0]); i++) {
+        printf("  %-22s %12.0f %12.0f\n", s_worst[i].name, s_worst[i].value, BUDGETS[i]);
+    }
+    if (save_dir) save_worst(save_dir);
+    if (s_failures) printf("  %d inputs over budget\n", s_failures);
+    return s_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,313 @@
+#pragma once
+// ============================================================================
+// Host stand-in for the Pebble SDK header (bench build only)
+// ============================================================================
+// Just enough of the SDK surface for src/c to compile on Linux.
+// GContext is backed by an in-memory framebuffer laid out like the real one
+// (aplite: 1-bit LSB-first, 1 = white; basalt/chalk: 8-bit GColor8, chalk
+// clipped to the round display) and persist_* by an in-memory key/value table.
+// The platform is picked with -DPBL_PLATFORM_APLITE/BASALT/CHALK.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// --- Platform ---
+#if defined(PBL_PLATFORM_CHALK)
+  #define PBL_COLOR
+  #define PBL_ROUND
+  #define PBL_DISPLAY_WIDTH 180
+  #define PBL_DISPLAY_HEIGHT 180
+#elif defined(PBL_PLATFORM_BASALT)
+  #define PBL_COLOR
+  #define PBL_RECT
+  #define PBL_DISPLAY_WIDTH 144
+  #define PBL_DISPLAY_HEIGHT 168
+#else
+  #ifndef PBL_PLATFORM_APLITE
+    #define PBL_PLATFORM_APLITE
+  #endif
+  #define PBL_BW
+  #define PBL_RECT
+  #define PBL_DISPLAY_WIDTH 144
+  #define PBL_DISPLAY_HEIGHT 168
+#endif
+
+// --- Geometry ---
+typedef struct GPoint { int16_t x; int16_t y; } GPoint;
+typedef struct GSize { int16_t w; int16_t h; } GSize;
+typedef struct GRect { GPoint origin; GSize size; } GRect;
+
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+
+typedef union GColor8 {
+    uint8_t argb;
+} GColor8;
+typedef GColor8 GColor;
+
+#define GColorBlack ((GColor8){.argb = 0xC0})
+#define GColorWhite ((GColor8){.argb = 0xFF})
+
+typedef enum { GCornerNone = 0 } GCornerMask;
+typedef enum {
+    GTextOverflowModeWordWrap,
+    GTextOverflowModeTrailingEllipsis,
+    GTextOverflowModeFill
+} GTextOverflowMode;
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+
+typedef struct GContext GContext;
+typedef struct GTextAttributes GTextAttributes;
+typedef const char *GFont;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+
+typedef enum {
+    GBitmapFormat1Bit = 0,
+    GBitmapFormat8Bit,
+    GBitmapFormat1BitPalette,
+    GBitmapFormat2BitPalette,
+    GBitmapFormat4BitPalette,
+    GBitmapFormat8BitCircular
+} GBitmapFormat;
+
+typedef struct GBitmap GBitmap;
+
+typedef struct {
+    uint8_t *data;  // data[x] is pixel x for min_x <= x <= max_x
+    int16_t min_x;
+    int16_t max_x;
+} GBitmapDataRowInfo;
+
+// --- Graphics ---
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment,
+                        GTextAttributes *attributes);
+GFont fonts_get_system_font(const char *font_key);
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap);
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y);
+
+// --- Persistent Storage ---
+#define PERSIST_DATA_MAX_LENGTH 256
+
+typedef int32_t status_t;
+#define S_SUCCESS 0
+#define E_OUT_OF_STORAGE (-6)
+#define E_DOES_NOT_EXIST (-10)
+
+bool persist_exists(uint32_t key);
+int persist_get_size(uint32_t key);
+int32_t persist_read_int(uint32_t key);
+bool persist_read_bool(uint32_t key);
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size);
+status_t persist_write_int(uint32_t key, int32_t value);
+status_t persist_write_bool(uint32_t key, bool value);
+int persist_write_data(uint32_t key, const void *data, size_t size);
+status_t persist_delete(uint32_t key);
+
+// --- Time ---
+#define SECONDS_PER_DAY 86400
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+// --- Heap ---
+// Not tracked on the host: both read 0 (memdebug.c, WALLET_DEBUG builds)
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
+
+// --- Logging ---
+typedef enum {
+    APP_LOG_LEVEL_ERROR = 1,
+    APP_LOG_LEVEL_WARNING = 50,
+    APP_LOG_LEVEL_INFO = 100,
+    APP_LOG_LEVEL_DEBUG = 200
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...);
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+
+// --- UI, timers and AppMessage (only main.c uses these: fuzz build) ---
+typedef struct Window Window;
+typedef struct Layer Layer;
+typedef struct MenuLayer MenuLayer;
+typedef struct AppTimer AppTimer;
+typedef void *ClickRecognizerRef;
+
+typedef enum { BUTTON_ID_BACK, BUTTON_ID_UP, BUTTON_ID_SELECT, BUTTON_ID_DOWN, NUM_BUTTONS } ButtonId;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+
+typedef void (*WindowHandler)(Window *window);
+typedef struct {
+    WindowHandler load;
+    WindowHandler appear;
+    WindowHandler disappear;
+    WindowHandler unload;
+} WindowHandlers;
+
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+typedef struct { uint16_t section; uint16_t row; } MenuIndex;
+typedef enum { MenuRowAlignNone, MenuRowAlignCenter, MenuRowAlignTop, MenuRowAlignBottom } MenuRowAlign;
+typedef struct {
+    uint16_t (*get_num_sections)(MenuLayer *menu_layer, void *context);
+    uint16_t (*get_num_rows)(MenuLayer *menu_layer, uint16_t section_index, void *context);
+    int16_t (*get_cell_height)(MenuLayer *menu_layer, MenuIndex *cell_index, void *context);
+    void (*draw_row)(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *context);
+    void (*select_click)(MenuLayer *menu_layer, MenuIndex *cell_index, void *context);
+} MenuLayerCallbacks;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_click_config_provider(Window *window, ClickConfigProvider provider);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_stack_push(Window *window, bool animated);
+ButtonId click_recognizer_get_button_id(ClickRecognizerRef recognizer);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_mark_dirty(Layer *layer);
+
+MenuLayer *menu_layer_create(GRect frame);
+void menu_layer_destroy(MenuLayer *menu_layer);
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer);
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks);
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window);
+void menu_layer_reload_data(MenuLayer *menu_layer);
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index, MenuRowAlign scroll_align, bool animated);
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle,
+                          GBitmap *icon);
+
+void light_enable(bool enable);
+void app_event_loop(void);
+
+typedef enum {
+    APP_LAUNCH_SYSTEM, APP_LAUNCH_USER, APP_LAUNCH_PHONE, APP_LAUNCH_WAKEUP, APP_LAUNCH_WORKER,
+    APP_LAUNCH_QUICK_LAUNCH, APP_LAUNCH_TIMELINE_ACTION, APP_LAUNCH_SMARTSTRAP
+} AppLaunchReason;
+AppLaunchReason launch_reason(void);
+
+typedef void (*AppTimerCallback)(void *data);
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer);
+
+typedef enum { TUPLE_BYTE_ARRAY = 0, TUPLE_CSTRING = 1, TUPLE_UINT = 2, TUPLE_INT = 3 } TupleType;
+typedef struct __attribute__((__packed__)) {
+    uint32_t key;
+    TupleType type : 8;
+    uint16_t length;
+    union {
+        uint8_t data[0];
+        char cstring[0];
+        uint8_t uint8;
+        uint32_t uint32;
+        int32_t int32;
+    } value[];
+} Tuple;
+
+typedef struct DictionaryIterator DictionaryIterator;
+typedef enum { DICT_OK = 0, DICT_NOT_ENOUGH_STORAGE = 1 << 1 } DictionaryResult;
+typedef enum { APP_MSG_OK = 0, APP_MSG_BUSY = 1 << 10 } AppMessageResult;
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *data, const uint16_t size);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value);
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+// The SDK generates these from package.json "messageKeys", in that order
+enum {
+    MESSAGE_KEY_CMD_SYNC_START = 10000,
+    MESSAGE_KEY_CMD_SYNC_MANIFEST,
+    MESSAGE_KEY_CMD_SYNC_DATA,
+    MESSAGE_KEY_CMD_SYNC_COMPLETE,
+    MESSAGE_KEY_CMD_FETCH_CONFIG,
+    MESSAGE_KEY_KEY_INDEX,
+    MESSAGE_KEY_KEY_NAME,
+    MESSAGE_KEY_KEY_DESCRIPTION,
+    MESSAGE_KEY_KEY_DATA,
+    MESSAGE_KEY_KEY_FORMAT,
+    MESSAGE_KEY_KEY_WIDTH,
+    MESSAGE_KEY_KEY_HEIGHT,
+    MESSAGE_KEY_KEY_INVERT,
+    MESSAGE_KEY_KEY_ENCODING,
+    MESSAGE_KEY_KEY_HASH,
+    MESSAGE_KEY_KEY_NEEDED,
+    MESSAGE_KEY_KEY_INBOX_SIZE,
+    MESSAGE_KEY_KEY_DATA_LEN,
+    MESSAGE_KEY_KEY_CHUNK_SIZE,
+    MESSAGE_KEY_KEY_SEQ,
+    MESSAGE_KEY_KEY_WALLET_HASH,
+    MESSAGE_KEY_CMD_SYNC_UP_TO_DATE,
+    MESSAGE_KEY_KEY_SORT,
+    MESSAGE_KEY_KEY_QUICK_LAUNCH,
+    MESSAGE_KEY_KEY_STORAGE_FULL, // Watch to phone only: not in the fuzzer's alphabet
+    MESSAGE_KEY_COUNT_ = MESSAGE_KEY_KEY_QUICK_LAUNCH - MESSAGE_KEY_CMD_SYNC_START + 1
+};
+
+// ============================================================================
+// Bench-only hooks (not part of the SDK)
+// ============================================================================
+
+typedef struct {
+    uint32_t fill_rect_calls;
+    uint32_t pixels_touched;   // Clipped area of every graphics_fill_rect
+    uint32_t text_calls;
+    uint32_t fb_captures;      // graphics_capture_frame_buffer calls
+    uint32_t persist_reads;    // persist_read_* calls
+    uint32_t persist_writes;   // persist_write_* and persist_delete calls
+    uint32_t persist_exists;   // persist_exists calls
+} FakeCounters;
+
+extern FakeCounters g_fake_counters;
+
+GContext *fake_gcontext(void);
+GRect fake_screen_bounds(void);
+bool fake_pixel_is_black(int x, int y);
+bool fake_pixel_visible(int x, int y); // Inside the display (chalk is round)
+uint32_t fake_framebuffer_hash(void);
+void fake_counters_reset(void);
+void fake_persist_reset(void);              // Empty, with the default quota
+#define FAKE_PERSIST_QUOTA 4096             // Per-app persist quota on the watch
+void fake_persist_set_quota(int bytes);
+int fake_persist_used(void);                // Bytes charged to the quota
+int fake_persist_key_cost(uint32_t key);    // What one key is charged, 0 if absent
+
+// UI fake (fake_ui.c): the window stack, timers and AppMessage are driven
+// by hand. Rendering walks the top window's layers into fake_gcontext().
+void fake_ui_reset(void);
+int fake_timers_run(void);                 // Fires due timers in order; returns how many
+void fake_ui_render(void);                 // Draws every layer of the top window
+void fake_ui_click(ButtonId button);
+void fake_ui_set_launch_reason(AppLaunchReason reason); // APP_LAUNCH_USER after a reset
+DictionaryIterator *fake_dict_begin(void); // Builds the next inbox message
+void fake_dict_add_int(DictionaryIterator *iter, uint32_t key, int32_t value);
+void fake_dict_add_data(DictionaryIterator *iter, uint32_t key, const uint8_t *data, uint16_t len);
+void fake_dict_add_cstring(DictionaryIterator *iter, uint32_t key, const char *str, uint16_t len);
+void fake_app_message_deliver(DictionaryIterator *iter);
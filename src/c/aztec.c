@@ -0,0 +1,388 @@
+#include "common.h"
+#include <string.h>
+
+#if WALLET_TEXT_ENCODERS
+
+// ============================================================================
+// COMPACT AZTEC GENERATOR
+// ============================================================================
+// Compact symbols with 1-4 layers (15x15 to 27x27), written as the same
+// continuously packed module bits as pre-rendered cards.
+// - Text is split into Upper/Lower/Mixed/Punct/Digit characters and Binary
+//   Shift runs, choosing the fewest bits (dynamic programming over the text)
+// - At least 33% + 11 bits of error correction (like common encoders), the
+//   smallest compact size that holds it
+// - Reed-Solomon in GF(64)/GF(256) for data and GF(16) for the mode message
+
+#define AZTEC_MAX_LAYERS 4
+#define AZTEC_MAX_SIZE (11 + 4 * AZTEC_MAX_LAYERS)
+#define AZTEC_MAX_BITS ((88 + 16 * AZTEC_MAX_LAYERS) * AZTEC_MAX_LAYERS) // 608
+#define AZTEC_MAX_WORDS 128  // Stuffed 6-bit words of AZTEC_MAX_BITS, with room
+#define AZTEC_MAX_DATA_WORDS 64 // Mode message holds data words - 1 in 6 bits
+#define AZTEC_MAX_INPUT 128
+#define AZTEC_EC_PERCENT 33
+#define AZTEC_EC_EXTRA_BITS 11
+
+#define AZTEC_GF_MODE 0x13   // GF(16), mode message
+#define AZTEC_GF_DATA6 0x43  // GF(64), 1-2 layers
+#define AZTEC_GF_DATA8 0x12D // GF(256), 3-4 layers
+
+// Character modes. Digit codes are 4 bits, the others 5.
+enum { MODE_UPPER, MODE_LOWER, MODE_DIGIT, MODE_MIXED, MODE_PUNCT, MODE_COUNT };
+
+static const uint8_t MODE_BITS[MODE_COUNT] = {5, 5, 4, 5, 5};
+
+// Latch from one mode to another: (bit count << 16) | code bits. Some go
+// through a third mode (Lower has no latch to Upper, Digit only to Upper).
+static const uint32_t LATCH[MODE_COUNT][MODE_COUNT] = {
+    {0, (5 << 16) + 28, (5 << 16) + 30, (5 << 16) + 29, (10 << 16) + (29 << 5) + 30},
+    {(9 << 16) + (30 << 4) + 14, 0, (5 << 16) + 30, (5 << 16) + 29, (10 << 16) + (29 << 5) + 30},
+    {(4 << 16) + 14, (9 << 16) + (14 << 5) + 28, 0, (9 << 16) + (14 << 5) + 29,
+     (14 << 16) + (14 << 10) + (29 << 5) + 30},
+    {(5 << 16) + 29, (5 << 16) + 28, (10 << 16) + (29 << 5) + 30, 0, (5 << 16) + 30},
+    {(5 << 16) + 31, (10 << 16) + (31 << 5) + 28, (10 << 16) + (31 << 5) + 30,
+     (10 << 16) + (31 << 5) + 29, 0},
+};
+
+#define LATCH_BITS(from, to) (LATCH[from][to] >> 16)
+
+#define CODE_PUNCT_SHIFT 0  // P/S in Upper, Lower, Mixed and Digit
+#define CODE_UPPER_SHIFT_L 28
+#define CODE_UPPER_SHIFT_D 15
+#define CODE_BINARY_SHIFT 31 // Upper, Lower and Mixed
+
+static const char PUNCT_CHARS[] = "!\"#$%&'()*+,-./:;<=>?[]{}"; // Codes 6-30
+static const char MIXED_CHARS[] = "@\\^_`|~";                   // Codes 20-26
+
+// Code of character c in a mode, 0 when the mode doesn't have it
+static int char_code(int mode, uint8_t c) {
+    switch (mode) {
+        case MODE_UPPER:
+            if (c >= 'A' && c <= 'Z') return c - 'A' + 2;
+            return (c == ' ') ? 1 : 0;
+        case MODE_LOWER:
+            if (c >= 'a' && c <= 'z') return c - 'a' + 2;
+            return (c == ' ') ? 1 : 0;
+        case MODE_DIGIT:
+            if (c >= '0' && c <= '9') return c - '0' + 2;
+            return (c == ' ') ? 1 : (c == ',') ? 12 : (c == '.') ? 13 : 0;
+        case MODE_MIXED: {
+            if (c >= 1 && c <= 13) return c + 1;
+            if (c >= 27 && c <= 31) return c - 12;
+            if (c == 127) return 27;
+            if (c == ' ') return 1;
+            const char *p = c ? strchr(MIXED_CHARS, c) : NULL;
+            return p ? 20 + (p - MIXED_CHARS) : 0;
+        }
+        default: {
+            if (c == '\r') return 1;
+            const char *p = c ? strchr(PUNCT_CHARS, c) : NULL;
+            return p ? 6 + (p - PUNCT_CHARS) : 0;
+        }
+    }
+}
+
+// Punct two-character codes: CR LF, ". ", ", ", ": "
+static int punct_pair_code(const uint8_t *s, int remaining) {
+    if (remaining < 2) return 0;
+    if (s[0] == '\r' && s[1] == '\n') return 2;
+    if (s[1] != ' ') return 0;
+    return (s[0] == '.') ? 3 : (s[0] == ',') ? 4 : (s[0] == ':') ? 5 : 0;
+}
+
+// ============================================================================
+// High-Level Encoding
+// ============================================================================
+// plan[i][m]: cheapest way to encode text[i..] when latched in mode m. A
+// step latches (maybe) to mode `use`, then encodes from there one of: a
+// character, a Punct pair, a Punct/Upper shifted character, or a Binary
+// Shift run of `run` bytes. Latches are resolved after the steps that stay
+// in a mode, as one latch (possibly through a third mode) is always enough.
+
+enum { STEP_CHAR, STEP_PAIR, STEP_PUNCT_SHIFT, STEP_PUNCT_SHIFT_PAIR, STEP_UPPER_SHIFT, STEP_BINARY };
+
+typedef struct {
+    uint16_t cost[AZTEC_MAX_INPUT + 1][MODE_COUNT];
+    uint8_t step[AZTEC_MAX_INPUT][MODE_COUNT]; // (use << 4) | step
+    uint8_t run[AZTEC_MAX_INPUT][MODE_COUNT];  // Binary Shift length
+} AztecPlan;
+
+#define PLAN_INF 0xFFFF
+
+// Cheapest step at position i that stays in mode m
+static uint32_t plan_stay(AztecPlan *p, const uint8_t *text, int len, int i, int m,
+                          uint8_t *step, uint8_t *run) {
+    uint8_t c = text[i];
+    uint32_t best = PLAN_INF;
+    #define TRY(cost_, step_, run_) do { uint32_t _c = (cost_); \
+        if (_c < best) { best = _c; *step = (step_); *run = (run_); } } while (0)
+    #define NEXT(k, mode) ((uint32_t)p->cost[i + (k)][mode])
+
+    if (char_code(m, c)) TRY(MODE_BITS[m] + NEXT(1, m), STEP_CHAR, 0);
+    int pair = punct_pair_code(text + i, len - i);
+    if (m == MODE_PUNCT) {
+        if (pair) TRY(5 + NEXT(2, m), STEP_PAIR, 0);
+    } else {
+        if (char_code(MODE_PUNCT, c)) TRY(MODE_BITS[m] + 5 + NEXT(1, m), STEP_PUNCT_SHIFT, 0);
+        if (pair) TRY(MODE_BITS[m] + 5 + NEXT(2, m), STEP_PUNCT_SHIFT_PAIR, 0);
+    }
+    if ((m == MODE_LOWER || m == MODE_DIGIT) && char_code(MODE_UPPER, c)) {
+        TRY(MODE_BITS[m] + 5 + NEXT(1, m), STEP_UPPER_SHIFT, 0);
+    }
+
+    // Binary Shift: from Punct and Digit via Upper, back in that mode after
+    int after = (m == MODE_PUNCT || m == MODE_DIGIT) ? MODE_UPPER : m;
+    uint32_t head = (after != m) ? LATCH_BITS(m, MODE_UPPER) : 0;
+    for (int k = 1; i + k <= len && k <= 31 + 2047; k++) {
+        uint32_t length_bits = (k <= 31) ? 5 : 16;
+        TRY(head + 5 + length_bits + 8 * k + NEXT(k, after), STEP_BINARY, k);
+    }
+    #undef NEXT
+    #undef TRY
+    return best;
+}
+
+static void plan_build(AztecPlan *p, const uint8_t *text, int len) {
+    for (int m = 0; m < MODE_COUNT; m++) p->cost[len][m] = 0;
+    for (int i = len - 1; i >= 0; i--) {
+        uint32_t stay[MODE_COUNT];
+        uint8_t step[MODE_COUNT], run[MODE_COUNT];
+        for (int m = 0; m < MODE_COUNT; m++) stay[m] = plan_stay(p, text, len, i, m, &step[m], &run[m]);
+
+        for (int m = 0; m < MODE_COUNT; m++) {
+            int use = m;
+            uint32_t best = stay[m];
+            for (int t = 0; t < MODE_COUNT; t++) {
+                if (t != m && LATCH_BITS(m, t) + stay[t] < best) {
+                    best = LATCH_BITS(m, t) + stay[t];
+                    use = t;
+                }
+            }
+            p->cost[i][m] = (best < PLAN_INF) ? best : PLAN_INF;
+            p->step[i][m] = (use << 4) | step[use];
+            p->run[i][m] = run[use];
+        }
+    }
+}
+
+static uint8_t s_az_bits[(AZTEC_MAX_BITS + 7) / 8];
+
+static int put_bits(int pos, uint32_t value, int n) {
+    for (int i = n - 1; i >= 0; i--, pos++) {
+        if (value & (1u << i)) s_az_bits[pos >> 3] |= 0x80 >> (pos & 7);
+    }
+    return pos;
+}
+
+static int put_latch(int pos, int from, int to) {
+    return put_bits(pos, LATCH[from][to] & 0xFFFF, LATCH_BITS(from, to));
+}
+
+// Walks the plan from Upper (the initial mode) into s_az_bits
+static int plan_emit(const AztecPlan *p, const uint8_t *text, int len) {
+    memset(s_az_bits, 0, sizeof(s_az_bits));
+    int pos = 0;
+    int mode = MODE_UPPER;
+    for (int i = 0; i < len;) {
+        int use = p->step[i][mode] >> 4;
+        int step = p->step[i][mode] & 0xF;
+        if (use != mode) pos = put_latch(pos, mode, use);
+        mode = use;
+        uint8_t c = text[i];
+        int bits = MODE_BITS[mode];
+        switch (step) {
+            case STEP_CHAR:
+                pos = put_bits(pos, char_code(mode, c), bits);
+                i++;
+                break;
+            case STEP_PAIR:
+                pos = put_bits(pos, punct_pair_code(text + i, len - i), 5);
+                i += 2;
+                break;
+            case STEP_PUNCT_SHIFT:
+                pos = put_bits(pos, CODE_PUNCT_SHIFT, bits);
+                pos = put_bits(pos, char_code(MODE_PUNCT, c), 5);
+                i++;
+                break;
+            case STEP_PUNCT_SHIFT_PAIR:
+                pos = put_bits(pos, CODE_PUNCT_SHIFT, bits);
+                pos = put_bits(pos, punct_pair_code(text + i, len - i), 5);
+                i += 2;
+                break;
+            case STEP_UPPER_SHIFT:
+                pos = put_bits(pos, (mode == MODE_DIGIT) ? CODE_UPPER_SHIFT_D : CODE_UPPER_SHIFT_L, bits);
+                pos = put_bits(pos, char_code(MODE_UPPER, c), 5);
+                i++;
+                break;
+            default: {
+                int k = p->run[i][mode];
+                if (mode == MODE_PUNCT || mode == MODE_DIGIT) {
+                    pos = put_latch(pos, mode, MODE_UPPER);
+                    mode = MODE_UPPER;
+                }
+                pos = put_bits(pos, CODE_BINARY_SHIFT, 5);
+                if (k <= 31) pos = put_bits(pos, k, 5);
+                else pos = put_bits(pos, (uint32_t)(k - 31), 16); // 5 zero bits, then 11
+                for (int j = 0; j < k; j++) pos = put_bits(pos, text[i + j], 8);
+                i += k;
+                break;
+            }
+        }
+    }
+    return pos;
+}
+
+// ============================================================================
+// Symbol
+// ============================================================================
+
+static uint8_t s_az_words[AZTEC_MAX_WORDS]; // Stuffed data words, then check words
+static uint32_t s_az_rows[AZTEC_MAX_SIZE];   // Column c at bit 31 - c
+
+// Splits bits into words, never all 0s or all 1s: a word whose first
+// word-1 bits are all equal gets the opposite bit and the next word starts
+// one bit earlier. The tail is padded with 1s. Returns the word count, -1 if
+// it doesn't fit.
+static int stuff_bits(int n_bits, int word) {
+    int mask = (1 << word) - 2;
+    int n = 0;
+    for (int i = 0; i < n_bits; i += word) {
+        int w = 0;
+        for (int j = 0; j < word; j++) {
+            bool bit = (i + j >= n_bits) || ((s_az_bits[(i + j) >> 3] >> (7 - ((i + j) & 7))) & 1);
+            if (bit) w |= 1 << (word - 1 - j);
+        }
+        if ((w & mask) == mask) {
+            w &= mask;
+            i--;
+        } else if ((w & mask) == 0) {
+            w |= 1;
+            i--;
+        }
+        if (n == AZTEC_MAX_WORDS) return -1;
+        s_az_words[n++] = w;
+    }
+    return n;
+}
+
+static inline void az_set(int x, int y) {
+    s_az_rows[y] |= (uint32_t)1 << (31 - x);
+}
+
+// Centre square, rings at 2 and 4, and the orientation marks at 5
+static void draw_bullseye(int center) {
+    for (int i = 0; i <= 4; i += 2) {
+        for (int j = center - i; j <= center + i; j++) {
+            az_set(j, center - i);
+            az_set(j, center + i);
+            az_set(center - i, j);
+            az_set(center + i, j);
+        }
+    }
+    az_set(center - 5, center - 5);
+    az_set(center - 4, center - 5);
+    az_set(center - 5, center - 4);
+    az_set(center + 5, center - 5);
+    az_set(center + 5, center - 4);
+    az_set(center + 5, center + 4);
+}
+
+// 28 bits: layers - 1 (2 bits), data words - 1 (6 bits), 5 GF(16) check words
+static void draw_mode_message(int center, int layers, int data_words) {
+    uint8_t mm[7];
+    int info = ((layers - 1) << 6) | (data_words - 1);
+    mm[0] = info >> 4;
+    mm[1] = info & 0xF;
+    gf_select(AZTEC_GF_MODE);
+    rs_encode(mm, 2, mm + 2, 5, 1);
+
+    #define MM_BIT(i) ((mm[(i) / 4] >> (3 - (i) % 4)) & 1)
+    for (int i = 0; i < 7; i++) {
+        int offset = center - 3 + i;
+        if (MM_BIT(i)) az_set(offset, center - 5);
+        if (MM_BIT(i + 7)) az_set(center + 5, offset);
+        if (MM_BIT(20 - i)) az_set(offset, center + 5);
+        if (MM_BIT(27 - i)) az_set(center - 5, offset);
+    }
+    #undef MM_BIT
+}
+
+// Data layers from the outside in, each as four 2-module-wide sides. The
+// message is `pad` zero bits, then the words MSB first.
+static void draw_layers(int size, int layers, int word, int pad) {
+    #define MSG_BIT(b) ((b) >= pad && \
+        ((s_az_words[((b) - pad) / word] >> (word - 1 - ((b) - pad) % word)) & 1))
+    for (int i = 0, offset = 0; i < layers; i++) {
+        int row_size = (layers - i) * 4 + 9;
+        for (int j = 0; j < row_size; j++) {
+            for (int k = 0; k < 2; k++) {
+                int b = offset + j * 2 + k;
+                if (MSG_BIT(b)) az_set(i * 2 + k, i * 2 + j);
+                if (MSG_BIT(b + row_size * 2)) az_set(i * 2 + j, size - 1 - i * 2 - k);
+                if (MSG_BIT(b + row_size * 4)) az_set(size - 1 - i * 2 - k, size - 1 - i * 2 - j);
+                if (MSG_BIT(b + row_size * 6)) az_set(size - 1 - i * 2 - j, i * 2 + k);
+            }
+        }
+        offset += row_size * 8;
+    }
+    #undef MSG_BIT
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool aztec_generate_packed(const char *data, int len, uint8_t *output_buffer, uint8_t *out_size) {
+    if (!data || !output_buffer || len <= 0 || len > AZTEC_MAX_INPUT) return false;
+    const uint8_t *text = (const uint8_t *)data;
+
+    // 1. High-level encoding
+    AztecPlan *plan = malloc(sizeof(AztecPlan));
+    if (!plan) return false;
+    plan_build(plan, text, len);
+    bool fits = plan->cost[0][MODE_UPPER] <= AZTEC_MAX_BITS;
+    int n_bits = fits ? plan_emit(plan, text, len) : 0;
+    free(plan);
+    if (!fits) return false;
+
+    // 2. Smallest size holding the stuffed words and the check bits
+    int ecc_bits = n_bits * AZTEC_EC_PERCENT / 100 + AZTEC_EC_EXTRA_BITS;
+    int layers, word = 0, n_words = -1, total_bits = 0;
+    for (layers = 1; layers <= AZTEC_MAX_LAYERS; layers++) {
+        total_bits = (88 + 16 * layers) * layers;
+        if (n_bits + ecc_bits > total_bits) continue;
+        int w = (layers <= 2) ? 6 : 8;
+        if (w != word) {
+            word = w;
+            n_words = stuff_bits(n_bits, word);
+        }
+        if (n_words < 0 || n_words > AZTEC_MAX_DATA_WORDS) continue;
+        if (n_words * word + ecc_bits <= total_bits - total_bits % word) break;
+    }
+    if (layers > AZTEC_MAX_LAYERS) return false;
+
+    // 3. Check words
+    int total_words = total_bits / word;
+    gf_select(word == 6 ? AZTEC_GF_DATA6 : AZTEC_GF_DATA8);
+    rs_encode(s_az_words, n_words, s_az_words + n_words, total_words - n_words, 1);
+
+    // 4. Matrix
+    int size = 11 + 4 * layers;
+    int center = size / 2;
+    memset(s_az_rows, 0, sizeof(s_az_rows));
+    draw_layers(size, layers, word, total_bits % word);
+    draw_mode_message(center, layers, n_words);
+    draw_bullseye(center);
+
+    // 5. Pack Output
+    *out_size = size;
+    memset(output_buffer, 0, (size * size + 7) / 8);
+    for (int r = 0, pos = 0; r < size; r++) {
+        for (int c = 0; c < size; c++, pos++) {
+            if (s_az_rows[r] & ((uint32_t)1 << (31 - c))) output_buffer[pos >> 3] |= 0x80 >> (pos & 7);
+        }
+    }
+    return true;
+}
+
+#endif
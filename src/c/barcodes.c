@@ -3,345 +3,653 @@
 
 
 // ============================================================================
-// Code 128 Barcode Rendering (our original implementation)
-// Supports Code 128B (alphanumeric) and Code 128C (numeric pairs)
+// Module Stream Reading
 // ============================================================================
+// Modules are continuously bit-packed, MSB first. Rows are scanned a 32-bit
+// word at a time so all-white stretches cost one load, and run boundaries
+// come from count-leading-zeros instead of testing each bit.
+
+// 32 module bits starting at bit `pos`, MSB first; bits at or past `end` read as 0.
+static inline uint32_t read_bits32(const uint8_t *bits, uint32_t pos, uint32_t end) {
+    const uint8_t *p = bits + (pos >> 3);
+    uint32_t avail = ((end + 7) >> 3) - (pos >> 3);
+    uint64_t v = 0;
+    for (uint32_t k = 0; k < 5; k++) v = (v << 8) | (k < avail ? p[k] : 0);
+    uint32_t word = (uint32_t)(v >> (8 - (pos & 7)));
+    if (end - pos < 32) word &= ~(0xFFFFFFFFu >> (end - pos));
+    return word;
+}
+
+// Finds the next run of black modules at or after column *c of the row that
+// starts at bit `row_base`. On success the run is [*c, *run_end). Modules at
+// or past bit `data_end` (a short buffer) read as white.
+static bool next_black_run(const uint8_t *bits, uint32_t row_base, uint16_t w, uint32_t data_end,
+                           uint16_t *c, uint16_t *run_end) {
+    uint32_t end = row_base + w;
+    uint32_t pos = row_base + *c;
+    if (end > data_end) end = data_end;
+
+    while (pos < end) {
+        uint32_t word = read_bits32(bits, pos, end);
+        if (word) { pos += __builtin_clz(word); break; }
+        pos += 32;
+    }
+    if (pos >= end) return false;
+    uint32_t start = pos;
 
-static const uint8_t CODE128_PATTERNS[][6] = {
-    {2, 1, 2, 2, 2, 2}, // 0: Space
-    {2, 2, 2, 1, 2, 2}, // 1: !
-    {2, 2, 2, 2, 2, 1}, // 2: "
-    {1, 2, 1, 2, 2, 3}, // 3: #
-    {1, 2, 1, 3, 2, 2}, // 4: $
-    {1, 3, 1, 2, 2, 2}, // 5: %
-    {1, 2, 2, 2, 1, 3}, // 6: &
-    {1, 2, 2, 3, 1, 2}, // 7: '
-    {1, 3, 2, 2, 1, 2}, // 8: (
-    {2, 2, 1, 2, 1, 3}, // 9: )
-    {2, 2, 1, 3, 1, 2}, // 10: *
-    {2, 3, 1, 2, 1, 2}, // 11: +
-    {1, 1, 2, 2, 3, 2}, // 12: ,
-    {1, 2, 2, 1, 3, 2}, // 13: -
-    {1, 2, 2, 2, 3, 1}, // 14: .
-    {1, 1, 3, 2, 2, 2}, // 15: /
-    {1, 2, 3, 1, 2, 2}, // 16: 0
-    {1, 2, 3, 2, 2, 1}, // 17: 1
-    {2, 2, 3, 2, 1, 1}, // 18: 2
-    {2, 2, 1, 1, 3, 2}, // 19: 3
-    {2, 2, 1, 2, 3, 1}, // 20: 4
-    {2, 1, 3, 2, 1, 2}, // 21: 5
-    {2, 2, 3, 1, 1, 2}, // 22: 6
-    {3, 1, 2, 1, 3, 1}, // 23: 7
-    {3, 1, 1, 2, 2, 2}, // 24: 8
-    {3, 2, 1, 1, 2, 2}, // 25: 9
-    {3, 2, 1, 2, 2, 1}, // 26: :
-    {3, 1, 2, 2, 1, 2}, // 27: ;
-    {3, 2, 2, 1, 1, 2}, // 28: <
-    {3, 2, 2, 2, 1, 1}, // 29: =
-    {2, 1, 2, 1, 2, 3}, // 30: >
-    {2, 1, 2, 3, 2, 1}, // 31: ?
-    {2, 3, 2, 1, 2, 1}, // 32: @
-    {1, 1, 1, 3, 2, 3}, // 33: A
-    {1, 3, 1, 1, 2, 3}, // 34: B
-    {1, 3, 1, 3, 2, 1}, // 35: C
-    {1, 1, 2, 3, 1, 3}, // 36: D
-    {1, 3, 2, 1, 1, 3}, // 37: E
-    {1, 3, 2, 3, 1, 1}, // 38: F
-    {2, 1, 1, 3, 1, 3}, // 39: G
-    {2, 3, 1, 1, 1, 3}, // 40: H
-    {2, 3, 1, 3, 1, 1}, // 41: I
-    {1, 1, 2, 1, 3, 3}, // 42: J
-    {1, 1, 2, 3, 3, 1}, // 43: K
-    {1, 3, 2, 1, 3, 1}, // 44: L
-    {1, 1, 3, 1, 2, 3}, // 45: M
-    {1, 1, 3, 3, 2, 1}, // 46: N
-    {1, 3, 3, 1, 2, 1}, // 47: O
-    {3, 1, 3, 1, 2, 1}, // 48: P
-    {2, 1, 1, 3, 3, 1}, // 49: Q
-    {2, 3, 1, 1, 3, 1}, // 50: R
-    {2, 1, 3, 1, 1, 3}, // 51: S
-    {2, 1, 3, 3, 1, 1}, // 52: T
-    {2, 1, 3, 1, 3, 1}, // 53: U
-    {3, 1, 1, 1, 2, 3}, // 54: V
-    {3, 1, 1, 3, 2, 1}, // 55: W
-    {3, 3, 1, 1, 2, 1}, // 56: X
-    {3, 1, 2, 1, 1, 3}, // 57: Y
-    {3, 1, 2, 3, 1, 1}, // 58: Z
-    {3, 3, 2, 1, 1, 1}, // 59: [
-    {3, 1, 4, 1, 1, 1}, // 60: backslash
-    {2, 2, 1, 4, 1, 1}, // 61: ]
-    {4, 3, 1, 1, 1, 1}, // 62: ^
-    {1, 1, 1, 2, 2, 4}, // 63: _
-    {1, 1, 1, 4, 2, 2}, // 64: `
-    {1, 2, 1, 1, 2, 4}, // 65: a
-    {1, 2, 1, 4, 2, 1}, // 66: b
-    {1, 4, 1, 1, 2, 2}, // 67: c
-    {1, 4, 1, 2, 2, 1}, // 68: d
-    {1, 1, 2, 2, 1, 4}, // 69: e
-    {1, 1, 2, 4, 1, 2}, // 70: f
-    {1, 2, 2, 1, 1, 4}, // 71: g
-    {1, 2, 2, 4, 1, 1}, // 72: h
-    {1, 4, 2, 1, 1, 2}, // 73: i
-    {1, 4, 2, 2, 1, 1}, // 74: j
-    {2, 4, 1, 2, 1, 1}, // 75: k
-    {2, 2, 1, 1, 1, 4}, // 76: l
-    {4, 1, 3, 1, 1, 1}, // 77: m
-    {2, 4, 1, 1, 1, 2}, // 78: n
-    {1, 3, 4, 1, 1, 1}, // 79: o
-    {1, 1, 1, 2, 4, 2}, // 80: p
-    {1, 2, 1, 1, 4, 2}, // 81: q
-    {1, 2, 1, 2, 4, 1}, // 82: r
-    {1, 1, 4, 2, 1, 2}, // 83: s
-    {1, 2, 4, 1, 1, 2}, // 84: t
-    {1, 2, 4, 2, 1, 1}, // 85: u
-    {4, 1, 1, 2, 1, 2}, // 86: v
-    {4, 2, 1, 1, 1, 2}, // 87: w
-    {4, 2, 1, 2, 1, 1}, // 88: x
-    {2, 1, 2, 1, 4, 1}, // 89: y
-    {2, 1, 4, 1, 2, 1}, // 90: z
-    {4, 1, 2, 1, 2, 1}, // 91: {
-    {1, 1, 1, 1, 4, 3}, // 92: |
-    {1, 1, 1, 3, 4, 1}, // 93: }
-    {1, 3, 1, 1, 4, 1}, // 94: ~
-    {1, 1, 4, 1, 1, 3}, // 95: DEL
-    {1, 1, 4, 3, 1, 1}, // 96: FNC3
-    {4, 1, 1, 1, 1, 3}, // 97: FNC2
-    {4, 1, 1, 3, 1, 1}, // 98: SHIFT
-    {1, 1, 3, 1, 4, 1}, // 99: Code C
-    {1, 1, 4, 1, 3, 1}, // 100: Code B / FNC4
-    {3, 1, 1, 1, 4, 1}, // 101: Code A / FNC4
-    {4, 1, 1, 1, 3, 1}, // 102: FNC1
-    {2, 1, 1, 4, 1, 2}, // 103: Start A
-    {2, 1, 1, 2, 1, 4}, // 104: Start B
-    {2, 1, 1, 2, 3, 2}, // 105: Start C
-};
-
-static const uint8_t CODE128_STOP[] = {2, 3, 3, 1, 1, 1, 2};
-
-// --- Helpers ---
-
-static void draw_bar(GContext *ctx, int x, int y, int width, int height, bool black) {
-    graphics_context_set_fill_color(ctx, black ? GColorBlack : GColorWhite);
-    graphics_fill_rect(ctx, GRect(x, y, width, height), 0, GCornerNone);
-}
-
-static bool is_all_digits(const char *str) {
-    for (int i = 0; str[i]; i++) {
-        if (str[i] < '0' || str[i] > '9') return false;
+    while (pos < end) {
+        uint32_t word = ~read_bits32(bits, pos, end);
+        if (word) { pos += __builtin_clz(word); break; }
+        pos += 32;
     }
+    if (pos > end) pos = end;
+
+    *c = start - row_base;
+    *run_end = pos - row_base;
     return true;
 }
 
-static int get_code128_value(char c) {
-    if (c >= 32 && c <= 127) return c - 32;
-    return 0;
+// ============================================================================
+// Module Sources
+// ============================================================================
+// Renderers walk a card row by row, top to bottom, asking for the black runs
+// of each row. The source hides how the card is stored:
+//
+// ENCODING_PACKED:  continuously bit-packed modules (above).
+// ENCODING_ROW_RLE: groups of identical rows, decoded in place. Each group
+//                   starts with a varint (repeat << 1 | raw). A run row
+//                   follows as alternating white/black run-length varints,
+//                   starting with white (possibly 0), until the runs cover
+//                   the width; a raw row as ceil(w / 8) bytes of packed
+//                   modules. The encoder picks whichever is shorter, so
+//                   dense 2D rows don't blow up. Varints are LEB128: 7 bits
+//                   per byte, low bits first.
+//
+// Nothing is expanded into a buffer; a malformed stream reads as white.
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t len;
+    uint16_t w, h;
+    CardEncoding encoding;
+    uint16_t row;
+    uint16_t col;          // Scan position within the row
+    int32_t bit_base;      // Bit offset of the current row when it's packed, else -1
+    // ENCODING_ROW_RLE
+    uint16_t group_pos;    // First byte after the group header
+    uint16_t group_left;   // Rows left in the current group, including this one
+    bool group_raw;
+    uint16_t pos;          // Next run varint
+    bool in_black;
+    bool repeat;           // Row is the previous one again (same group): reuse its runs
+} ModuleSource;
+
+// Reads a LEB128 varint at *pos; returns false at the end of the data.
+static bool read_varint(const uint8_t *data, uint16_t len, uint16_t *pos, uint32_t *value) {
+    uint32_t v = 0;
+    for (int shift = 0; *pos < len && shift < 28; shift += 7) {
+        uint8_t b = data[(*pos)++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *value = v;
+            return true;
+        }
+    }
+    *pos = len;
+    return false;
+}
+
+static void rle_start_group(ModuleSource *src, uint16_t pos) {
+    uint32_t header = 0;
+    bool ok = read_varint(src->data, src->len, &pos, &header);
+    uint32_t repeat = header >> 1;
+    src->group_raw = ok && (header & 1);
+    // A raw row must be complete; past the end everything is white
+    if (src->group_raw && (uint32_t)pos + (src->w + 7) / 8 > src->len) ok = src->group_raw = false;
+    if (!ok) repeat = 0xFFFF;
+    src->group_left = (repeat == 0) ? 1 : (repeat > 0xFFFF ? 0xFFFF : repeat);
+    src->group_pos = ok ? pos : src->len;
+}
+
+// Offset just past the row data of the current group
+static uint16_t rle_group_end(const ModuleSource *src) {
+    if (src->group_raw) return src->group_pos + (src->w + 7) / 8;
+    uint16_t pos = src->group_pos;
+    uint32_t col = 0, run = 0;
+    while (col < src->w && read_varint(src->data, src->len, &pos, &run)) col += run;
+    return pos;
+}
+
+static void source_init(ModuleSource *src, CardEncoding encoding, uint16_t w, uint16_t h,
+                        const uint8_t *data, uint16_t len) {
+    memset(src, 0, sizeof(*src));
+    src->data = data;
+    src->len = len;
+    src->w = w;
+    src->h = h;
+    src->encoding = encoding;
+    src->bit_base = 0;
+    if (encoding == ENCODING_ROW_RLE) rle_start_group(src, 0);
+}
+
+// Positions the source at the start of row r. Rows only move forward; going
+// back restarts the stream.
+static void source_seek_row(ModuleSource *src, uint16_t r) {
+    src->repeat = false;
+    if (src->encoding == ENCODING_ROW_RLE) {
+        uint16_t prev_group = src->group_pos;
+        src->repeat = (r == src->row + 1);
+        if (r < src->row) source_init(src, src->encoding, src->w, src->h, src->data, src->len);
+        while (src->row < r) {
+            if (--src->group_left == 0) rle_start_group(src, rle_group_end(src));
+            src->row++;
+        }
+        src->repeat = src->repeat && src->group_pos == prev_group;
+        src->pos = src->group_pos;
+        src->in_black = false;
+        src->bit_base = src->group_raw ? (int32_t)src->group_pos * 8 : -1;
+    } else if ((uint32_t)r * src->w < (uint32_t)src->len * 8) {
+        src->bit_base = (int32_t)r * src->w;
+    } else {
+        // Row past the end of a short buffer: no varints left, reads as white
+        src->bit_base = -1;
+        src->pos = src->len;
+    }
+    src->row = r;
+    src->col = 0;
+}
+
+// Starts the scan of the current row at column c when the row is
+// bit-addressable; run-length rows are read from their start.
+static void source_skip_to(ModuleSource *src, uint16_t c) {
+    if (src->bit_base >= 0 && c < src->w) src->col = c;
 }
 
-static int calculate_code128_checksum(const char *data) {
-    int checksum = 104; // Start B
-    int len = strlen(data);
-    for (int i = 0; i < len && i < MAX_DATA_LEN; i++) {
-        checksum += get_code128_value(data[i]) * (i + 1);
+// Next black run [*c, *run_end) of the current row
+static bool source_next_black_run(ModuleSource *src, uint16_t *c, uint16_t *run_end) {
+    if (src->bit_base >= 0) {
+        if (!next_black_run(src->data, src->bit_base, src->w, (uint32_t)src->len * 8, &src->col, run_end)) return false;
+        *c = src->col;
+        src->col = *run_end;
+        return true;
     }
-    return checksum % 103;
-}
-
-static int calculate_code128c_checksum(const char *data) {
-    int checksum = 105; // Start C
-    int len = strlen(data);
-    int pos = 1;
-    for (int i = 0; i < len; i += 2) {
-        int value = (data[i] - '0') * 10;
-        if (i + 1 < len) value += (data[i + 1] - '0');
-        checksum += value * pos;
-        pos++;
+
+    uint32_t run = 0;
+    while (src->col < src->w) {
+        if (!read_varint(src->data, src->len, &src->pos, &run)) {
+            src->col = src->w;
+            return false;
+        }
+        uint32_t end = src->col + run;
+        if (end > src->w) end = src->w;
+        bool black = src->in_black;
+        src->in_black = !black;
+        if (!black || run == 0) {
+            src->col = end;
+            continue;
+        }
+        *c = src->col;
+        *run_end = end;
+        src->col = end;
+        return true;
     }
-    return checksum % 103;
+    return false;
 }
 
-// --- Code 128 Barcode Drawing ---
+// ============================================================================
+// Rect Sink
+// ============================================================================
+// The fill_rect renderers emit black rectangles through a sink that either
+// draws them right away or records them into a display list (see
+// barcode_compile_display_list).
+
+typedef struct {
+    GContext *ctx;       // Draw immediately when set
+    GRect bounds;        // Recording: rects are clipped to this
+    DisplayRect *rects;  // Recording: output list
+    uint16_t count;
+    uint16_t max;
+    bool overflow;
+} RectSink;
+
+static void sink_rect(RectSink *sink, int x, int y, int w, int h) {
+    if (sink->ctx) {
+        graphics_fill_rect(sink->ctx, GRect(x, y, w, h), 0, GCornerNone);
+        return;
+    }
+    int x1 = x + w, y1 = y + h;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 > sink->bounds.size.w) x1 = sink->bounds.size.w;
+    if (y1 > sink->bounds.size.h) y1 = sink->bounds.size.h;
+    if (x >= x1 || y >= y1) return;
+    if (sink->count >= sink->max) {
+        sink->overflow = true;
+        return;
+    }
+    sink->rects[sink->count++] = (DisplayRect){ .x = x, .y = y, .w = x1 - x, .h = y1 - y };
+}
 
-static void draw_code128_barcode(GContext *ctx, GRect bounds, const char *data) {
-    int data_len = strlen(data);
-    if (data_len == 0 || data_len > MAX_DATA_LEN) return;
+// ============================================================================
+// Rectangle Coalescing (2D module matrices)
+// ============================================================================
+// Black modules are merged into horizontal runs per row, and a run that
+// repeats with identical columns on the next row extends the rectangle above
+// it instead of starting a new one. Each maximal rectangle is one fill call.
+
+// Open rects a row can extend; past that a run is drawn as a one-row rect.
+// Aplite only coalesces when it can't capture the framebuffer (it keeps no
+// display lists), so it holds fewer.
+#if defined(PBL_PLATFORM_APLITE)
+#define COALESCE_MAX_RUNS 32
+#else
+#define COALESCE_MAX_RUNS 64
+#endif
+
+typedef struct {
+    uint16_t c0, c1; // Columns [c0, c1)
+    uint16_t r0;     // Row the rectangle was opened on
+} ModuleRect;
+
+static ModuleRect s_open_rects[COALESCE_MAX_RUNS];
+static ModuleRect s_next_rects[COALESCE_MAX_RUNS];
+
+static void fill_module_rect(RectSink *sink, int ox, int oy, int scale, const ModuleRect *m, int r_end) {
+    sink_rect(sink, ox + m->c0 * scale, oy + m->r0 * scale,
+              (m->c1 - m->c0) * scale, (r_end - m->r0) * scale);
+}
+
+// Module rows [*r0, *r1) of a `scale` matrix at oy that land on rows [0, screen_h)
+static void visible_rows(int oy, int scale, int h, int screen_h, int *r0, int *r1) {
+    *r0 = (oy < 0) ? -oy / scale : 0;
+    *r1 = (oy + h * scale > screen_h) ? (screen_h - oy + scale - 1) / scale : h;
+    if (*r1 < *r0) *r1 = *r0;
+}
+
+// Only modules on columns [0, x_end) and rows [0, screen_h) become rects, so
+// a code larger than the screen costs what the screen shows.
+static void fill_modules_coalesced(RectSink *sink, int ox, int oy, int scale, ModuleSource *src,
+                                   int x_end, int screen_h) {
+    int open_count = 0;
+    int r_begin, h;
+    visible_rows(oy, scale, src->h, screen_h, &r_begin, &h);
+
+    bool all_open = false; // Every run of the last row is an open rect
+    for (int r = r_begin; r <= h; r++) {
+        int next_count = 0;
+        int i = 0;
+        uint16_t c = 0, c_end = 0;
+
+        // The pass at r == h has no runs and just flushes what is still open.
+        if (r < h) source_seek_row(src, r);
+        if (r < h && r > r_begin && src->repeat && all_open) continue; // Open rects grow a row
+        if (r < h && ox < 0) source_skip_to(src, -ox / scale);
+        all_open = true;
+        while (r < h && source_next_black_run(src, &c, &c_end) && ox + c * scale < x_end) {
+            if (ox + c_end * scale <= 0) continue; // Left of the screen
+            ModuleRect run = { .c0 = c, .c1 = c_end, .r0 = r };
+
+            // Close open rects that end before or diverge from this run
+            while (i < open_count && s_open_rects[i].c0 <= run.c0 &&
+                   !(s_open_rects[i].c0 == run.c0 && s_open_rects[i].c1 == run.c1)) {
+                fill_module_rect(sink, ox, oy, scale, &s_open_rects[i++], r);
+            }
+            if (i < open_count && s_open_rects[i].c0 == run.c0 && s_open_rects[i].c1 == run.c1) {
+                run.r0 = s_open_rects[i++].r0;
+            }
 
-    bool is_numeric = is_all_digits(data);
-    bool use_code_c = is_numeric;
+            if (next_count < COALESCE_MAX_RUNS) s_next_rects[next_count++] = run;
+            else {
+                fill_module_rect(sink, ox, oy, scale, &run, r + 1); // Too many runs: draw as-is
+                all_open = false;
+            }
+        }
 
-    char padded_data[MAX_DATA_LEN + 2] = {0}; // Initialized to silence 'unused variable' warning
-    const char *barcode_data = data;
-    int barcode_len = data_len;
+        while (i < open_count) fill_module_rect(sink, ox, oy, scale, &s_open_rects[i++], r);
 
-    if (is_numeric && (data_len % 2 == 1)) {
-        padded_data[0] = '0';
-        strncpy(padded_data + 1, data, MAX_DATA_LEN);
-        padded_data[MAX_DATA_LEN + 1] = '\0';
-        barcode_data = padded_data;
-        barcode_len = data_len + 1;
+        memcpy(s_open_rects, s_next_rects, next_count * sizeof(ModuleRect));
+        open_count = next_count;
     }
+}
 
-    int bar_modules;
-    if (use_code_c) {
-        int pairs = barcode_len / 2;
-        bar_modules = 11 + (pairs * 11) + 11 + 13;
-    } else {
-        bar_modules = 11 + (barcode_len * 11) + 11 + 13;
+// ============================================================================
+// Direct Framebuffer Blitter
+// ============================================================================
+// Writes modules straight into the captured framebuffer instead of going
+// through graphics_fill_rect. A module row is expanded once into a scanline
+// and then stored into each of its `scale` framebuffer rows. The kernel is
+// picked at compile time: aplite has a 1-bit framebuffer (LSB-first,
+// 0 = black), basalt/chalk one GColor8 byte per pixel (chalk rows are
+// clipped to the round display). Codes larger than the screen are clipped;
+// layers that don't cover the framebuffer fall back to the fill_rect
+// renderers.
+
+#define BLIT_FB_W PBL_DISPLAY_WIDTH
+
+typedef struct {
+    GBitmap *bitmap;
+    uint8_t *data;
+    uint16_t stride;
+    int16_t w, h;
+} Framebuffer;
+
+static bool fb_begin(GContext *ctx, GRect bounds, Framebuffer *fb) {
+    fb->bitmap = graphics_capture_frame_buffer(ctx);
+    if (!fb->bitmap) return false;
+
+    GRect fb_bounds = gbitmap_get_bounds(fb->bitmap);
+#if defined(PBL_BW)
+    bool format_ok = (gbitmap_get_format(fb->bitmap) == GBitmapFormat1Bit);
+#elif defined(PBL_ROUND)
+    bool format_ok = (gbitmap_get_format(fb->bitmap) == GBitmapFormat8BitCircular);
+#else
+    bool format_ok = (gbitmap_get_format(fb->bitmap) == GBitmapFormat8Bit);
+#endif
+    if (!format_ok || fb_bounds.size.w > BLIT_FB_W ||
+        bounds.origin.x != 0 || bounds.origin.y != 0 ||
+        bounds.size.w != fb_bounds.size.w || bounds.size.h != fb_bounds.size.h) {
+        graphics_release_frame_buffer(ctx, fb->bitmap);
+        return false;
     }
 
-    int bar_height = bounds.size.h - 50;
-    int bar_y = 25;
-    int screen_margin = 6;
-    int available_width = bounds.size.w - (screen_margin * 2);
-    int module_width = available_width / bar_modules;
-    if (module_width < 1) module_width = 1;
+    fb->data = gbitmap_get_data(fb->bitmap);
+    fb->stride = gbitmap_get_bytes_per_row(fb->bitmap);
+    fb->w = fb_bounds.size.w;
+    fb->h = fb_bounds.size.h;
+    return true;
+}
 
-    int barcode_width = bar_modules * module_width;
-    int start_x = screen_margin + (available_width - barcode_width) / 2;
-    if (start_x < screen_margin) start_x = screen_margin;
-    int right_limit = bounds.size.w - screen_margin;
+static void fb_end(GContext *ctx, Framebuffer *fb) {
+    graphics_release_frame_buffer(ctx, fb->bitmap);
+}
 
-    // White background
-    graphics_context_set_fill_color(ctx, GColorWhite);
-    graphics_fill_rect(ctx, GRect(screen_margin, bar_y - 5, available_width, bar_height + 10), 0, GCornerNone);
+// Row y and its visible pixel span [*min_x, *max_x]
+static inline uint8_t *fb_row(const Framebuffer *fb, int y, int *min_x, int *max_x) {
+#if defined(PBL_ROUND)
+    GBitmapDataRowInfo info = gbitmap_get_data_row_info(fb->bitmap, y);
+    *min_x = info.min_x;
+    *max_x = info.max_x;
+    return info.data;
+#else
+    *min_x = 0;
+    *max_x = fb->w - 1;
+    return fb->data + y * fb->stride;
+#endif
+}
+
+#if defined(PBL_BW)
+
+// --- 1-bit kernel (aplite) ---
+// The scanline holds "ink" bits in framebuffer order (pixel x = bit x % 32 of
+// word x / 32) and is applied with row &= ~ink. For scales up to 8 a nibble
+// of modules expands to 4*scale pixels through a 16-entry table.
+
+#define BLIT_SCAN_WORDS ((BLIT_FB_W + 31) / 32 + 1)
+#define BLIT_LUT_MAX_SCALE 8
 
-    int x = start_x;
+static uint32_t s_scan[BLIT_SCAN_WORDS];
+static uint32_t s_expand_lut[16];
+static int s_expand_scale = 0;
 
-    if (use_code_c) {
-        // Start C (index 105)
-        for (int i = 0; i < 6 && x < right_limit; i++) {
-            int w = CODE128_PATTERNS[105][i] * module_width;
-            if (x + w > right_limit) w = right_limit - x;
-            draw_bar(ctx, x, bar_y, w, bar_height, (i % 2 == 0));
-            x += w;
+static void build_expand_lut(int scale) {
+    if (s_expand_scale == scale) return;
+    uint32_t module_px = (scale >= 32) ? 0xFFFFFFFFu : ((1u << scale) - 1);
+    for (int n = 0; n < 16; n++) {
+        uint32_t v = 0;
+        for (int k = 0; k < 4; k++) {
+            if (n & (8 >> k)) v |= module_px << (k * scale);
         }
-        // Digit pairs
-        for (int i = 0; i < barcode_len && x < right_limit; i += 2) {
-            int value = (barcode_data[i] - '0') * 10;
-            if (i + 1 < barcode_len) value += (barcode_data[i + 1] - '0');
-            for (int j = 0; j < 6 && x < right_limit; j++) {
-                int w = CODE128_PATTERNS[value][j] * module_width;
-                if (x + w > right_limit) w = right_limit - x;
-                draw_bar(ctx, x, bar_y, w, bar_height, (j % 2 == 0));
-                x += w;
+        s_expand_lut[n] = v;
+    }
+    s_expand_scale = scale;
+}
+
+// ORs `nbits` (<= 32) ink bits into the scanline at pixel x
+static inline void scan_put(int x, uint32_t value, int nbits) {
+    int i = x >> 5, sh = x & 31;
+    s_scan[i] |= value << sh;
+    if (sh && sh + nbits > 32) s_scan[i + 1] |= value >> (32 - sh);
+}
+
+static void scan_span(int x0, int x1) {
+    while (x0 < x1) {
+        int n = x1 - x0;
+        if (n > 32 - (x0 & 31)) n = 32 - (x0 & 31);
+        uint32_t bits = (n == 32) ? 0xFFFFFFFFu : ((1u << n) - 1);
+        s_scan[x0 >> 5] |= bits << (x0 & 31);
+        x0 += n;
+    }
+}
+
+static void scan_apply(const Framebuffer *fb, int y, int x0, int x1) {
+    int min_x, max_x;
+    uint32_t *row = (uint32_t *)fb_row(fb, y, &min_x, &max_x);
+    for (int i = x0 >> 5; i <= (x1 - 1) >> 5; i++) row[i] &= ~s_scan[i];
+}
+
+static void blit_expand_row(ModuleSource *src, int ox, int scale, int x0, int x1) {
+    memset(s_scan, 0, sizeof(s_scan));
+    bool whole_row = (x0 == ox && x1 == ox + src->w * scale);
+    if (src->bit_base >= 0 && scale <= BLIT_LUT_MAX_SCALE && whole_row) {
+        build_expand_lut(scale);
+        const uint8_t *bits = src->data;
+        uint32_t row_base = src->bit_base;
+        uint32_t end = row_base + src->w;
+        if (end > (uint32_t)src->len * 8) end = (uint32_t)src->len * 8; // Short buffer reads as white
+        int x = ox;
+        for (uint32_t pos = row_base; pos < end; pos += 32, x += 32 * scale) {
+            uint32_t word = read_bits32(bits, pos, end);
+            for (int k = 0; word; k++, word <<= 4) {
+                uint32_t nib = word >> 28;
+                if (nib) scan_put(x + k * 4 * scale, s_expand_lut[nib], 4 * scale);
             }
         }
-        // Checksum
-        int checksum = calculate_code128c_checksum(barcode_data);
-        for (int i = 0; i < 6 && x < right_limit; i++) {
-            int w = CODE128_PATTERNS[checksum][i] * module_width;
-            if (x + w > right_limit) w = right_limit - x;
-            draw_bar(ctx, x, bar_y, w, bar_height, (i % 2 == 0));
-            x += w;
-        }
     } else {
-        // Start B (index 104)
-        for (int i = 0; i < 6 && x < right_limit; i++) {
-            int w = CODE128_PATTERNS[104][i] * module_width;
-            if (x + w > right_limit) w = right_limit - x;
-            draw_bar(ctx, x, bar_y, w, bar_height, (i % 2 == 0));
-            x += w;
-        }
-        // Data characters
-        for (int i = 0; i < barcode_len && x < right_limit; i++) {
-            int value = get_code128_value(barcode_data[i]);
-            for (int j = 0; j < 6 && x < right_limit; j++) {
-                int w = CODE128_PATTERNS[value][j] * module_width;
-                if (x + w > right_limit) w = right_limit - x;
-                draw_bar(ctx, x, bar_y, w, bar_height, (j % 2 == 0));
-                x += w;
-            }
-        }
-        // Checksum
-        int checksum = calculate_code128_checksum(barcode_data);
-        for (int i = 0; i < 6 && x < right_limit; i++) {
-            int w = CODE128_PATTERNS[checksum][i] * module_width;
-            if (x + w > right_limit) w = right_limit - x;
-            draw_bar(ctx, x, bar_y, w, bar_height, (i % 2 == 0));
-            x += w;
+        uint16_t c = 0, c_end = 0;
+        if (ox < x0) source_skip_to(src, (x0 - ox) / scale);
+        while (source_next_black_run(src, &c, &c_end) && ox + c * scale < x1) {
+            int a = ox + c * scale, b = ox + c_end * scale;
+            scan_span(a < x0 ? x0 : a, b > x1 ? x1 : b);
         }
     }
+}
 
-    // Stop pattern
-    for (int i = 0; i < 7 && x < right_limit; i++) {
-        int w = CODE128_STOP[i] * module_width;
-        if (x + w > right_limit) w = right_limit - x;
-        draw_bar(ctx, x, bar_y, w, bar_height, (i % 2 == 0));
-        x += w;
-    }
+static void blit_store_row(const Framebuffer *fb, int y, int x0, int x1) {
+    scan_apply(fb, y, x0, x1);
 }
 
-// ============================================================================
-// QR Code Drawing (on-watch fallback for small alphanumeric QR)
-// ============================================================================
+static void blit_bar_rows(const Framebuffer *fb, int y0, int y1, int x0, int x1) {
+    for (int y = y0; y < y1; y++) scan_apply(fb, y, x0, x1);
+}
 
-static void draw_qr_code_onwatch(GContext *ctx, GRect bounds, const char *data) {
-    uint8_t packed[200];
-    uint8_t size = 0;
+static void blit_bar_prepare(int x0, int x1) {
+    memset(s_scan, 0, sizeof(s_scan));
+    scan_span(x0, x1);
+}
 
-    // Note: qr_generate_packed must be available in the project
-    // If missing, this fallback will fail to link.
-    // Assuming it exists based on "exact same app" description.
-    if (qr_generate_packed(data, packed, &size)) {
-        int avail = (bounds.size.w < bounds.size.h ? bounds.size.w : bounds.size.h) - 10;
-        int scale = avail / size;
-        if (scale < 2) scale = 2;
-        int pix_size = size * scale;
-        int ox = (bounds.size.w - pix_size) / 2;
-        int oy = (bounds.size.h - pix_size) / 2;
+#else
 
-        graphics_context_set_fill_color(ctx, GColorWhite);
-        graphics_fill_rect(ctx, GRect(ox - 4, oy - 4, pix_size + 8, pix_size + 8), 0, GCornerNone);
+// --- 8-bit kernel (basalt, chalk) ---
+// One byte per pixel: the scanline (in screen columns) is built with memset
+// per black run and copied into each framebuffer row, clipped to the row's
+// visible span.
 
-        graphics_context_set_fill_color(ctx, GColorBlack);
-        for (int r = 0; r < size; r++) {
-            for (int c = 0; c < size; c++) {
-                int idx = r * size + c;
-                if (packed[idx / 8] & (1 << (7 - (idx % 8)))) {
-                    graphics_fill_rect(ctx, GRect(ox + c * scale, oy + r * scale, scale, scale), 0, GCornerNone);
-                }
-            }
+static uint8_t s_scan8[BLIT_FB_W];
+
+static void blit_expand_row(ModuleSource *src, int ox, int scale, int x0, int x1) {
+    memset(s_scan8 + x0, GColorWhite.argb, x1 - x0);
+    uint16_t c = 0, c_end = 0;
+    if (ox < x0) source_skip_to(src, (x0 - ox) / scale);
+    while (source_next_black_run(src, &c, &c_end) && ox + c * scale < x1) {
+        int a = ox + c * scale, b = ox + c_end * scale;
+        if (a < x0) a = x0;
+        if (b > x1) b = x1;
+        if (a < b) memset(s_scan8 + a, GColorBlack.argb, b - a);
+    }
+}
+
+static void blit_store_row(const Framebuffer *fb, int y, int x0, int x1) {
+    int min_x, max_x;
+    uint8_t *row = fb_row(fb, y, &min_x, &max_x);
+    if (x0 < min_x) x0 = min_x;
+    if (x1 > max_x + 1) x1 = max_x + 1;
+    if (x0 < x1) memcpy(row + x0, s_scan8 + x0, x1 - x0);
+}
+
+static void blit_bar_prepare(int x0, int x1) {
+    // Nothing to precompute: bars are a memset per row
+}
+
+static void blit_bar_rows(const Framebuffer *fb, int y0, int y1, int x0, int x1) {
+    for (int y = y0; y < y1; y++) {
+        int min_x, max_x;
+        uint8_t *row = fb_row(fb, y, &min_x, &max_x);
+        int cx0 = (x0 < min_x) ? min_x : x0;
+        int cx1 = (x1 > max_x + 1) ? max_x + 1 : x1;
+        if (cx0 < cx1) memset(row + cx0, GColorBlack.argb, cx1 - cx0);
+    }
+}
+
+#endif
+
+// Draws a w x h module matrix at (ox, oy), `scale` pixels per module,
+// clipped to the screen: only the modules it shows are read.
+static bool blit_modules(GContext *ctx, GRect bounds, int ox, int oy, int scale, ModuleSource *src) {
+    Framebuffer fb;
+    if (!fb_begin(ctx, bounds, &fb)) return false;
+    int x0 = (ox < 0) ? 0 : ox;
+    int x1 = (ox + src->w * scale > fb.w) ? fb.w : ox + src->w * scale;
+    int r0, r1;
+    visible_rows(oy, scale, src->h, fb.h, &r0, &r1);
+    for (int r = r0; r < r1 && x0 < x1; r++) {
+        source_seek_row(src, r);
+        if (r == r0 || !src->repeat) blit_expand_row(src, ox, scale, x0, x1);
+        for (int k = 0; k < scale; k++) {
+            int y = oy + r * scale + k;
+            if (y >= 0 && y < fb.h) blit_store_row(&fb, y, x0, x1);
         }
-    } else {
-        graphics_context_set_text_color(ctx, GColorBlack);
-        graphics_draw_text(ctx, "QR Too Large",
-            fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), bounds,
-            GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
     }
+    fb_end(ctx, &fb);
+    return true;
+}
+
+// Draws the black runs of module row r as horizontal bars spanning
+// [x0, x0 + bar_len), module c covering rows [y_offset + c*scale, +scale),
+// or the rows its edge table gives.
+static bool blit_bars(GContext *ctx, GRect bounds, int x0, int bar_len, int y_offset, int scale,
+                      const ModuleEdges *edges, ModuleSource *src, int r) {
+    if (x0 < 0 || x0 + bar_len > bounds.size.w) return false;
+
+    Framebuffer fb;
+    if (!fb_begin(ctx, bounds, &fb)) return false;
+    blit_bar_prepare(x0, x0 + bar_len);
+    source_seek_row(src, r);
+    uint16_t c = 0, c_end = 0;
+    while (source_next_black_run(src, &c, &c_end)) {
+        int y0 = edges ? edges->origin + edges->edge[c] : y_offset + c * scale;
+        int y1 = edges ? edges->origin + edges->edge[c_end] : y_offset + c_end * scale;
+        if (y0 >= fb.h) break;
+        if (y0 < 0) y0 = 0;
+        if (y1 > fb.h) y1 = fb.h;
+        if (y0 < y1) blit_bar_rows(&fb, y0, y1, x0, x0 + bar_len);
+    }
+    fb_end(ctx, &fb);
+    return true;
+}
+
+// --- Invert ---
+// Inverted codes are drawn as usual and then flipped in one XOR pass over
+// the captured framebuffer, a word at a time: every bit on aplite; on
+// basalt/chalk the colour bits, which swaps GColorBlack (0xC0) and
+// GColorWhite (0xFF) and keeps alpha.
+
+#if defined(PBL_BW)
+#define INVERT_WORD 0xFFFFFFFFu
+#else
+#define INVERT_WORD 0x3F3F3F3Fu
+#endif
+
+static void invert_span(uint8_t *p, int n) {
+    for (; n >= 4; n -= 4, p += 4) {
+        uint32_t w;
+        memcpy(&w, p, 4);
+        w ^= INVERT_WORD;
+        memcpy(p, &w, 4);
+    }
+    for (; n > 0; n--, p++) *p ^= (uint8_t)INVERT_WORD;
+}
+
+bool barcode_invert(GContext *ctx, GRect bounds) {
+    Framebuffer fb;
+    if (!fb_begin(ctx, bounds, &fb)) return false;
+#if defined(PBL_ROUND)
+    for (int y = 0; y < fb.h; y++) {
+        int min_x, max_x;
+        uint8_t *row = fb_row(&fb, y, &min_x, &max_x);
+        invert_span(row + min_x, max_x - min_x + 1);
+    }
+#else
+    // Rows are contiguous: one pass, row padding included
+    invert_span(fb.data, fb.h * fb.stride);
+#endif
+    fb_end(ctx, &fb);
+    return true;
+}
+
+// Framebuffer fast path first, coalesced fill_rects otherwise
+static void draw_modules(GContext *ctx, GRect bounds, int ox, int oy, int scale, ModuleSource *src) {
+    if (blit_modules(ctx, bounds, ox, oy, scale, src)) return;
+    RectSink sink = { .ctx = ctx };
+    fill_modules_coalesced(&sink, ox, oy, scale, src, bounds.size.w, bounds.size.h);
 }
 
 // ============================================================================
 // NEW RENDERERS (v1.4 - RLE and 2D Matrix)
 // ============================================================================
 
-// Renders 2D codes (QR, Aztec, PDF417) by scaling them to fit the screen.
-static void draw_2d_centered(GContext *ctx, GRect bounds, uint16_t w, uint16_t h, const uint8_t *bits) {
+// Screen placement of a pre-rendered code, shared by drawing and compiling
+typedef struct {
+    int scale;       // Pixels per module; 0 when `edges` places the modules
+    int x_offset;
+    int y_offset;
+    int bar_len;     // 1D: bar length across the screen
+    int span;        // 1D: pixels the modules cover along the code
+    int row;         // 1D: module row sampled for the bars
+    const ModuleEdges *edges; // 1D: module positions along the code
+} BarcodeLayout;
+
+// 2D codes (QR, Aztec, PDF417): integer scaling, centered.
+static void layout_2d(GRect bounds, uint16_t w, uint16_t h, BarcodeLayout *l) {
     int screen_w = bounds.size.w;
     int screen_h = bounds.size.h;
 
     int scale_w = screen_w / w;
     int scale_h = screen_h / h;
-    int scale = (scale_w < scale_h) ? scale_w : scale_h;
-    if (scale < 1) scale = 1;
-
-    int barcode_pixel_w = w * scale;
-    int barcode_pixel_h = h * scale;
-    int x_offset = (screen_w - barcode_pixel_w) / 2;
-    int y_offset = (screen_h - barcode_pixel_h) / 2;
-
-    for (int r = 0; r < (int)h; r++) {
-        for (int c = 0; c < (int)w; c++) {
-            int bit_idx = r * w + c;
-            bool is_black = (bits[bit_idx / 8] & (1 << (7 - (bit_idx % 8))));
-            if (is_black) {
-                graphics_fill_rect(ctx, GRect(x_offset + c * scale, y_offset + r * scale, scale, scale), 0, GCornerNone);
-            }
-        }
-    }
+    l->scale = (scale_w < scale_h) ? scale_w : scale_h;
+    if (l->scale < 1) l->scale = 1;
+
+    l->x_offset = (screen_w - w * l->scale) / 2;
+    l->y_offset = (screen_h - h * l->scale) / 2;
+    l->bar_len = 0;
+    l->span = 0;
+    l->row = 0;
+    l->edges = NULL;
 }
 
-// Renders 1D codes (Code128, etc.) rotated 90 degrees to maximize length.
-// Uses module-based integer scaling to preserve exact bar width ratios.
-static void draw_1d_rotated(GContext *ctx, GRect bounds, uint16_t w, uint16_t h, const uint8_t *bits) {
+// 1D codes (Code128, etc.) rotated 90 degrees to maximize length.
+// 2px/module or more: integer scaling keeps the bar width ratios exact.
+// Below that a fractional scale (scale 0, placed by the module edge table)
+// is used only where the rounded widths still decode: spread over the whole
+// span from 1.75px/module, or exactly 1.5px/module (3px per 2 modules).
+// Otherwise 1px/module, the margins shrinking to a quiet zone of
+// QUIET_ZONE_MODULES at each end if needed. A module can't be narrower than
+// a pixel and the bars can't be split, so a code longer than the screen
+// height less both quiet zones (148 modules on aplite/basalt, 160 on chalk)
+// can't be drawn readably at all: returns false. The phone refuses such
+// codes (see watchCanEncode in pebble-js-app.js).
+#define QUIET_ZONE_MODULES 10
+
+static bool layout_1d(GRect bounds, uint16_t w, uint16_t h, BarcodeLayout *l) {
     int screen_w = bounds.size.w;
     int screen_h = bounds.size.h;
 
@@ -349,108 +657,353 @@ static void draw_1d_rotated(GContext *ctx, GRect bounds, uint16_t w, uint16_t h,
     int margin = 20; 
     int available_h = screen_h - (margin * 2);
 
-    // Integer scaling only to preserve critical bar ratios
-    int scale = available_h / w;
-    if (scale < 1) scale = 1;
-
-    int drawn_h = w * scale;
-    int y_offset = margin + (available_h - drawn_h) / 2;
+    l->scale = available_h / w;
+    if (l->scale >= 2) l->span = w * l->scale;
+    else if (4 * available_h >= 7 * w) l->span = available_h;
+    else if (2 * available_h >= 3 * w) l->span = 3 * w / 2;
+    else if (w + 2 * QUIET_ZONE_MODULES <= screen_h && w <= EDGE_MAX_MODULES) l->span = w;
+    else return false;
+    if (l->scale < 2) l->scale = (l->span == w) ? 1 : 0;
+    l->y_offset = (screen_h - l->span) / 2;
 
     // Bar length (horizontal thickness on screen) - Increased side margins for better scan
-    int bar_len = screen_w - 40; 
-    int x_offset = (screen_w - bar_len) / 2;
+    l->bar_len = screen_w - 40; 
+    l->x_offset = (screen_w - l->bar_len) / 2;
 
     // Sample row: use h/2 but ensure it's within bounds
-    int r = (h > 0) ? (h / 2) : 0;
-    if (r >= h && h > 0) r = h - 1;
-
-    // RLE: group consecutive black modules into single draw calls
-    int run_start = -1;
-    for (int c = 0; c < (int)w; c++) {
-        int bit_idx = r * w + c; 
-        bool is_black = (bits[bit_idx / 8] & (1 << (7 - (bit_idx % 8))));
-
-        if (is_black) {
-            if (run_start == -1) run_start = c;
-        } else {
-            if (run_start != -1) {
-                int run_px = (c - run_start) * scale;
-                int y_pos = y_offset + run_start * scale;
-                graphics_fill_rect(ctx, GRect(x_offset, y_pos, bar_len, run_px), 0, GCornerNone);
-                run_start = -1;
-            }
+    l->row = (h > 0) ? (h / 2) : 0;
+    if (l->row >= h && h > 0) l->row = h - 1;
+    l->edges = NULL;
+    return true;
+}
+
+// ============================================================================
+// Module Edge Tables
+// ============================================================================
+// Pixel position of every module of a 1D code, built once per card (the card
+// cache keeps it in the slot) so drawing is a walk over the black runs.
+// Module c covers [origin + edge[c], origin + edge[c + 1]).
+//
+// Integer scales place module c at c * scale. A fractional scale rounds
+// c * span / modules, which spreads the error evenly over the code; with at
+// least 1px per module every module keeps 1 or 2 pixels.
+
+static bool edges_build(ModuleEdges *e, GRect bounds, const BarcodeLayout *l, int modules) {
+    e->modules = 0;
+    if (modules == 0 || modules > EDGE_MAX_MODULES) return false;
+    if (l->span < modules || l->span > 255) return false;
+
+    for (int c = 0; c <= modules; c++) {
+        e->edge[c] = (l->scale > 0) ? c * l->scale : (c * l->span + modules / 2) / modules;
+    }
+    e->screen_w = bounds.size.w;
+    e->screen_h = bounds.size.h;
+    e->origin = l->y_offset;
+    e->modules = modules;
+    return true;
+}
+
+// Edge table for the 1D layout `l`: the caller's when it matches this
+// screen, otherwise built into `scratch`. Every code layout_1d accepts
+// gets one (EDGE_MAX_MODULES covers the tallest screen); NULL only when
+// building fails, which integer scales don't need.
+static const ModuleEdges *layout_edges(GRect bounds, const BarcodeLayout *l, ModuleSource *src,
+                                       const ModuleEdges *cached, ModuleEdges *scratch) {
+    if (cached && cached->modules == src->w &&
+        cached->screen_w == bounds.size.w && cached->screen_h == bounds.size.h) return cached;
+    if (edges_build(scratch, bounds, l, src->w)) return scratch;
+    return NULL;
+}
+
+static inline int module_px(const BarcodeLayout *l, int c) {
+    return l->edges ? l->edges->origin + l->edges->edge[c] : l->y_offset + c * l->scale;
+}
+
+// RLE: group consecutive black modules into single bars. Bars off the
+// screen_h rows are skipped.
+static void emit_bars(RectSink *sink, const BarcodeLayout *l, ModuleSource *src, int screen_h) {
+    source_seek_row(src, l->row);
+    uint16_t c = 0, c_end = 0;
+    while (source_next_black_run(src, &c, &c_end)) {
+        int y0 = module_px(l, c), y1 = module_px(l, c_end);
+        if (y0 >= screen_h) break;
+        if (y1 > 0) sink_rect(sink, l->x_offset, y0, l->bar_len, y1 - y0);
+    }
+}
+
+static void draw_2d_centered(GContext *ctx, GRect bounds, ModuleSource *src) {
+    BarcodeLayout l;
+    layout_2d(bounds, src->w, src->h, &l);
+    draw_modules(ctx, bounds, l.x_offset, l.y_offset, l.scale, src);
+}
+
+// False when the code is too long for the screen (nothing drawn)
+static bool draw_1d_rotated(GContext *ctx, GRect bounds, ModuleSource *src, const ModuleEdges *edges) {
+    static ModuleEdges scratch;
+    BarcodeLayout l;
+    if (!layout_1d(bounds, src->w, src->h, &l)) return false;
+    l.edges = layout_edges(bounds, &l, src, edges, &scratch);
+    if (blit_bars(ctx, bounds, l.x_offset, l.bar_len, l.y_offset, l.scale, l.edges, src, l.row)) return true;
+
+    RectSink sink = { .ctx = ctx };
+    emit_bars(&sink, &l, src, bounds.size.h);
+    return true;
+}
+
+static bool is_1d_format(BarcodeFormat format) {
+    return format == FORMAT_CODE128 || format == FORMAT_CODE39 || format == FORMAT_EAN13 ||
+           format == FORMAT_UPCA || format == FORMAT_EAN8;
+}
+
+// Text cards (no pre-rendered data): codes are encoded on the watch into
+// the same module stream the phone sends, then laid out, cached and drawn
+// like a pre-rendered card. 1D codes become one packed row, QR and Aztec a
+// packed square, each in its own buffer: encoding a 1D card (the card
+// cache prefetching a neighbour) leaves the cached 2D symbol alone. The 1D
+// row only has to hold what layout_1d can draw.
+#if WALLET_TEXT_ENCODERS
+#define TEXT_2D_LEN (QR_PACKED_MAX_LEN > AZTEC_PACKED_MAX_LEN ? QR_PACKED_MAX_LEN : AZTEC_PACKED_MAX_LEN)
+
+static uint8_t s_text_modules[TEXT_2D_LEN];
+static uint8_t s_text_row[(EDGE_MAX_MODULES + 7) / 8];
+
+// The last 2D symbol is kept: redraws of the same text (invert, card flips
+// back) skip generation and QR mask selection. Texts longer than
+// MAX_DATA_LEN are regenerated each time.
+static BarcodeFormat s_text_format;
+static char s_text_key[MAX_DATA_LEN + 1];
+static uint8_t s_text_size = 0; // 0: nothing cached
+
+static uint8_t text_generate_2d(BarcodeFormat format, const char *text, int n) {
+    if (s_text_size && format == s_text_format && n == (int)strlen(s_text_key) &&
+        memcmp(text, s_text_key, n) == 0) {
+        return s_text_size;
+    }
+    uint8_t size = 0;
+    MEM_PROBE_BEGIN();
+    bool ok = (format == FORMAT_QR) ? qr_generate_packed(text, n, s_text_modules, &size)
+                                    : aztec_generate_packed(text, n, s_text_modules, &size);
+    MEM_PROBE_END(format == FORMAT_QR ? "qr" : "aztec");
+    s_text_size = (ok && n <= MAX_DATA_LEN) ? size : 0;
+    if (s_text_size) {
+        memcpy(s_text_key, text, n);
+        s_text_key[n] = '\0';
+        s_text_format = format;
+    }
+    return ok ? size : 0;
+}
+
+// The buffer holds the text, maybe without a terminator. A 1D code longer
+// than EDGE_MAX_MODULES keeps its full width with no modules behind it:
+// layout_1d rejects it and it is drawn as too long.
+static bool text_source(BarcodeFormat format, const uint8_t *data, uint16_t len, ModuleSource *src) {
+    int n = 0;
+    if (format == FORMAT_QR || format == FORMAT_AZTEC) {
+        while (n < len && data[n]) n++;
+        uint8_t size = text_generate_2d(format, (const char *)data, n);
+        source_init(src, ENCODING_PACKED, size, size, s_text_modules, sizeof(s_text_modules));
+        return size > 0;
+    }
+    if (!is_1d_format(format)) return false;
+
+    while (n < len && n < MAX_DATA_LEN && data[n]) n++;
+    int modules = linear_encode(format, (const char *)data, n, s_text_row, EDGE_MAX_MODULES);
+    if (modules < 0) {
+        source_init(src, ENCODING_PACKED, -modules, 1, s_text_row, 0);
+        return true;
+    }
+    source_init(src, ENCODING_PACKED, modules, 1, s_text_row, sizeof(s_text_row));
+    return modules > 0;
+}
+#else
+// No encoders on this platform: the phone sends modules, so only a card
+// stored by an older version is text
+static bool text_source(BarcodeFormat format, const uint8_t *data, uint16_t len, ModuleSource *src) {
+    return false;
+}
+#endif
+
+bool barcode_build_edges(GRect bounds, BarcodeFormat format, CardEncoding encoding,
+                         uint16_t w, uint16_t h, const uint8_t *data, uint16_t len, ModuleEdges *out) {
+    out->modules = 0;
+    if (!data || !is_1d_format(format)) return false;
+    ModuleSource src;
+    if (encoding != ENCODING_TEXT) source_init(&src, encoding, w, h, data, len);
+    else if (!text_source(format, data, len, &src)) return false;
+    if (src.w == 0 || src.h == 0) return false;
+
+    BarcodeLayout l;
+    return layout_1d(bounds, src.w, src.h, &l) && edges_build(out, bounds, &l, src.w);
+}
+
+#if WALLET_DISPLAY_LISTS
+// ============================================================================
+// Display Lists
+// ============================================================================
+// A pre-rendered card compiled for one screen: the layout is resolved and the
+// modules coalesced into black rectangles once, at sync time. Redrawing is a
+// walk over the rectangles. Layout: DisplayListHeader, then rect_count
+// DisplayRects in final pixel coordinates.
+
+int barcode_compile_display_list(GRect bounds, BarcodeFormat format, CardEncoding encoding,
+                                 uint16_t w, uint16_t h, const uint8_t *data, uint16_t len,
+                                 uint8_t *out, int max_len) {
+    if (!data || max_len < (int)sizeof(DisplayListHeader)) return 0;
+    if (bounds.size.w > 255 || bounds.size.h > 255) return 0;
+
+    // Text cards are encoded here, as at draw time
+    static ModuleEdges scratch;
+    ModuleSource src;
+    if (encoding != ENCODING_TEXT) source_init(&src, encoding, w, h, data, len);
+    else if (!text_source(format, data, len, &src)) return 0;
+    if (src.w == 0 || src.h == 0) return 0;
+    BarcodeLayout l;
+    if (is_1d_format(format)) {
+        if (!layout_1d(bounds, src.w, src.h, &l)) return 0; // Drawn as "Code too long"
+        l.edges = layout_edges(bounds, &l, &src, NULL, &scratch);
+    } else {
+        layout_2d(bounds, src.w, src.h, &l);
+    }
+
+    RectSink sink = {
+        .bounds = bounds,
+        .rects = (DisplayRect *)(out + sizeof(DisplayListHeader)),
+        .max = (max_len - sizeof(DisplayListHeader)) / sizeof(DisplayRect),
+    };
+    if (is_1d_format(format)) emit_bars(&sink, &l, &src, bounds.size.h);
+    else fill_modules_coalesced(&sink, l.x_offset, l.y_offset, l.scale, &src, bounds.size.w, bounds.size.h);
+    if (sink.overflow) return 0;
+
+    DisplayListHeader header = {
+        .version = DLIST_VERSION,
+        .screen_w = bounds.size.w,
+        .screen_h = bounds.size.h,
+        .scale = l.scale,
+        .x_offset = l.x_offset,
+        .y_offset = l.y_offset,
+        .rect_count = sink.count,
+    };
+    memcpy(out, &header, sizeof(header));
+    return sizeof(header) + sink.count * sizeof(DisplayRect);
+}
+
+// Whether a list can beat drawing the card from its payload. Replaying pays
+// off for 1D codes and PDF417, whose bars coalesce into few rects; QR and
+// Aztec modules blit faster than their list replays (chalk: QR v1 6.1 us
+// from 56 bytes of modules, 11.2 us from its 318-byte list). A list is also
+// only worth storing when it is smaller than the payload (the caller's check).
+bool barcode_display_list_pays(BarcodeFormat format) {
+    return format != FORMAT_QR && format != FORMAT_AZTEC;
+}
+
+bool barcode_display_list_valid(const uint8_t *dlist, int len, GRect bounds) {
+    if (!dlist || len < (int)sizeof(DisplayListHeader)) return false;
+    DisplayListHeader header;
+    memcpy(&header, dlist, sizeof(header));
+    return header.version == DLIST_VERSION &&
+           header.screen_w == bounds.size.w && header.screen_h == bounds.size.h &&
+           (int)(sizeof(header) + header.rect_count * sizeof(DisplayRect)) <= len;
+}
+
+bool barcode_draw_display_list(GContext *ctx, GRect bounds, const uint8_t *dlist, int len) {
+    if (!barcode_display_list_valid(dlist, len, bounds)) return false;
+    DisplayListHeader header;
+    memcpy(&header, dlist, sizeof(header));
+    const DisplayRect *rects = (const DisplayRect *)(dlist + sizeof(header));
+
+    graphics_context_set_fill_color(ctx, GColorWhite);
+    graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+
+    // Rects were clipped to the screen at compile time
+    Framebuffer fb;
+    if (fb_begin(ctx, bounds, &fb)) {
+        for (int i = 0; i < header.rect_count; i++) {
+            const DisplayRect *r = &rects[i];
+            blit_bar_prepare(r->x, r->x + r->w);
+            blit_bar_rows(&fb, r->y, r->y + r->h, r->x, r->x + r->w);
         }
+        fb_end(ctx, &fb);
+        return true;
     }
-    // Flush last run
-    if (run_start != -1) {
-        int run_px = (w - run_start) * scale;
-        int y_pos = y_offset + run_start * scale;
-        graphics_fill_rect(ctx, GRect(x_offset, y_pos, bar_len, run_px), 0, GCornerNone);
+
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    for (int i = 0; i < header.rect_count; i++) {
+        graphics_fill_rect(ctx, GRect(rects[i].x, rects[i].y, rects[i].w, rects[i].h), 0, GCornerNone);
     }
+    return true;
 }
+#endif
 
 // ============================================================================
 // Main Dispatcher
 // ============================================================================
 
-void barcode_draw(GContext *ctx, GRect bounds, BarcodeFormat format,
-                  uint16_t width, uint16_t height, const uint8_t *bits) {
+static void draw_message(GContext *ctx, GRect bounds, const char *message) {
+    graphics_context_set_text_color(ctx, GColorBlack);
+    graphics_draw_text(ctx, message,
+        fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), bounds,
+        GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+}
+
+#define TOO_LONG_MESSAGE "Code too long\nfor this screen"
+
+void barcode_draw(GContext *ctx, GRect bounds, BarcodeFormat format, CardEncoding encoding,
+                  uint16_t width, uint16_t height, const uint8_t *bits, uint16_t len,
+                  const ModuleEdges *edges) {
     // Clear background
     graphics_context_set_fill_color(ctx, GColorWhite);
     graphics_fill_rect(ctx, bounds, 0, GCornerNone);
 
     // --- Pre-rendered binary data from bwip-js ---
-    if (width > 0 && height > 0 && bits) {
+    if (encoding != ENCODING_TEXT && width > 0 && height > 0 && bits) {
         graphics_context_set_fill_color(ctx, GColorBlack);
+        ModuleSource src;
+        source_init(&src, encoding, width, height, bits, len);
         
         switch(format) {
             case FORMAT_CODE128:
             case FORMAT_CODE39:
             case FORMAT_EAN13:
-                draw_1d_rotated(ctx, bounds, width, height, bits);
+            case FORMAT_UPCA:
+            case FORMAT_EAN8:
+                if (!draw_1d_rotated(ctx, bounds, &src, edges)) draw_message(ctx, bounds, TOO_LONG_MESSAGE);
                 break;
 
             case FORMAT_QR:
             case FORMAT_AZTEC:
             case FORMAT_PDF417:
-                draw_2d_centered(ctx, bounds, width, height, bits);
+                draw_2d_centered(ctx, bounds, &src);
                 break;
 
             default: 
                 // Should not happen, but draw_2d is a safe fallback
-                draw_2d_centered(ctx, bounds, width, height, bits);
+                draw_2d_centered(ctx, bounds, &src);
                 break;
         }
         return;
     }
 
-    // Fallback: no pre-rendered data. Bits buffer contains raw text.
-    // This handles demo cards and edge cases.
+    // Text cards: the bits buffer holds the source text
     const char *text_data = (const char *)bits;
-    if (!text_data || text_data[0] == '\0') {
-        graphics_context_set_text_color(ctx, GColorBlack);
-        graphics_draw_text(ctx, "No Data\nSync from phone",
-            fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), bounds,
-            GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    if (!text_data || text_data[0] == '\0' || encoding != ENCODING_TEXT) {
+        draw_message(ctx, bounds, "No Data\nSync from phone");
         return;
     }
 
-    switch (format) {
-        case FORMAT_CODE128:
-        case FORMAT_CODE39:
-            draw_code128_barcode(ctx, bounds, text_data);
-            break;
-
-        case FORMAT_QR:
-            draw_qr_code_onwatch(ctx, bounds, text_data);
-            break;
-
-        default:
-            // EAN13, Aztec, PDF417 without pre-rendering - can't render on watch
-            graphics_context_set_text_color(ctx, GColorBlack);
-            graphics_draw_text(ctx, "Resync from phone",
-                fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), bounds,
-                GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
-            break;
+    // 1D codes, QR and Aztec are encoded here. The phone only sends text
+    // that encodes (see watchCanEncode in pebble-js-app.js); these messages
+    // cover cards stored by older versions.
+    ModuleSource src;
+    if (text_source(format, bits, len, &src)) {
+        graphics_context_set_fill_color(ctx, GColorBlack);
+        if (!is_1d_format(format)) draw_2d_centered(ctx, bounds, &src);
+        else if (!draw_1d_rotated(ctx, bounds, &src, edges)) draw_message(ctx, bounds, TOO_LONG_MESSAGE);
+        return;
     }
+
+    const char *message = !WALLET_TEXT_ENCODERS ? "Resync from phone"
+                        : is_1d_format(format) ? "Invalid code\nCheck the number"
+                        : (format == FORMAT_QR || format == FORMAT_AZTEC) ? "Code too large\nResync from phone"
+                        : "Resync from phone"; // PDF417 is only pre-rendered
+    draw_message(ctx, bounds, message);
 }
@@ -0,0 +1,153 @@
+#include "common.h"
+
+// ============================================================================
+// Ready-to-draw card cache
+// ============================================================================
+// A small LRU of card payloads loaded from storage, so flipping between cards
+// in the detail window swaps buffers instead of reading flash. The card being
+// shown is pinned: prefetching its neighbours never evicts it.
+// Slots are malloc'd the first time they're needed rather than held in bss
+// (about 1.3 KB each), and handed back by card_cache_trim when something else
+// runs short of heap. When a new slot can't be had, an allocated one is reused.
+// A card's stored display list is preferred when it was compiled for the
+// current screen; otherwise the slot holds the packed module bits (and, for
+// 1D codes, their module edge table).
+
+typedef struct {
+    int16_t index;      // Card index, -1 when empty
+    uint32_t last_used;
+    CardPayload payload;
+    uint8_t data[MAX_BITS_LEN > DLIST_MAX_LEN ? MAX_BITS_LEN : DLIST_MAX_LEN];
+} CardCacheSlot;
+
+static CardCacheSlot *s_slots[CARD_CACHE_SLOTS]; // NULL until first needed
+static GRect s_screen;
+static uint32_t s_clock = 0;
+static int s_pinned = -1;
+
+static CardCacheSlot *cache_find(int index) {
+    for (int i = 0; i < CARD_CACHE_SLOTS; i++) {
+        if (s_slots[i] && s_slots[i]->index == index) return s_slots[i];
+    }
+    return NULL;
+}
+
+// Empty slot first, then a new one, otherwise the least recently used one
+// that isn't pinned
+static CardCacheSlot *cache_victim(void) {
+    CardCacheSlot *victim = NULL;
+    int unallocated = -1;
+    for (int i = 0; i < CARD_CACHE_SLOTS; i++) {
+        CardCacheSlot *s = s_slots[i];
+        if (!s) {
+            if (unallocated < 0) unallocated = i;
+            continue;
+        }
+        if (s->index < 0) return s;
+        if (s->index == s_pinned) continue;
+        if (!victim || s->last_used < victim->last_used) victim = s;
+    }
+    if (unallocated >= 0) {
+        CardCacheSlot *s = malloc(sizeof(CardCacheSlot));
+        if (s) {
+            s->index = -1;
+            s_slots[unallocated] = s;
+            return s;
+        }
+    }
+    return victim;
+}
+
+static CardCacheSlot *cache_load(int index) {
+    CardCacheSlot *slot = cache_victim();
+    if (!slot) return NULL;
+    slot->payload.data = slot->data;
+
+    WalletCardInfo *info = &slot->payload.info;
+    if (!storage_load_card_info(index, info)) {
+        // Damaged info record: the index entry has everything needed to draw
+        const CardIndexEntry *e = storage_index_entry(index);
+        memset(info, 0, sizeof(*info));
+        if (e) {
+            info->format = (BarcodeFormat)e->format;
+            info->width = e->width;
+            info->height = e->height;
+            info->encoding = (e->width && e->height) ? ENCODING_PACKED : ENCODING_TEXT;
+            strncpy(info->name, e->name, MAX_NAME_LEN - 1);
+        }
+    }
+
+    PROFILE_START(load_start);
+    slot->payload.display_list = false;
+#if WALLET_DISPLAY_LISTS
+    int len = storage_load_display_list(index, slot->data, DLIST_MAX_LEN);
+    if (barcode_display_list_valid(slot->data, len, s_screen)) {
+        slot->payload.len = len;
+        slot->payload.display_list = true;
+    }
+#endif
+    if (!slot->payload.display_list) {
+        // A damaged record leaves an empty payload rather than garbage modules
+        memset(slot->data, 0, MAX_BITS_LEN);
+        int len = storage_load_card_data(index, slot->data, MAX_BITS_LEN);
+        slot->payload.len = (len > 0) ? len : 0;
+    }
+    slot->payload.edges.modules = 0;
+    if (!slot->payload.display_list && slot->payload.len > 0) {
+        barcode_build_edges(s_screen, info->format, info->encoding, info->width, info->height,
+                            slot->data, slot->payload.len, &slot->payload.edges);
+    }
+    PROFILE_RECORD(PROFILE_LOAD, info->format, load_start);
+    slot->index = index;
+    return slot;
+}
+
+// Display lists compiled for other screen sizes are ignored
+void card_cache_set_screen(GRect bounds) {
+    if (bounds.size.w == s_screen.size.w && bounds.size.h == s_screen.size.h) return;
+    s_screen = bounds;
+    card_cache_clear();
+}
+
+// NULL when no slot could be allocated
+const CardPayload *card_cache_get(int index) {
+    if (index < 0 || index >= g_card_count) return NULL;
+
+    CardCacheSlot *slot = cache_find(index);
+    s_pinned = -1; // The previous card may be evicted if it's the LRU
+    if (!slot) slot = cache_load(index);
+    if (!slot) return NULL;
+    s_pinned = index;
+    slot->last_used = ++s_clock;
+    return &slot->payload;
+}
+
+void card_cache_prefetch(int index) {
+    if (index < 0 || index >= g_card_count || cache_find(index)) return;
+    CardCacheSlot *slot = cache_load(index);
+    if (slot) slot->last_used = ++s_clock;
+}
+
+bool card_cache_contains(int index) {
+    return cache_find(index) != NULL;
+}
+
+void card_cache_invalidate(int index) {
+    CardCacheSlot *slot = cache_find(index);
+    if (slot) slot->index = -1;
+}
+
+// Frees every slot but the pinned card's; the shown card stays drawable
+void card_cache_trim(void) {
+    for (int i = 0; i < CARD_CACHE_SLOTS; i++) {
+        if (s_slots[i] && (s_slots[i]->index < 0 || s_slots[i]->index != s_pinned)) {
+            free(s_slots[i]);
+            s_slots[i] = NULL;
+        }
+    }
+}
+
+void card_cache_clear(void) {
+    s_pinned = -1;
+    card_cache_trim();
+}
@@ -3,10 +3,21 @@
 
 // --- Constants ---
 #define MAX_DATA_LEN 100 // Max length for barcode string data (e.g., for Code128 input)
-#define MAX_CARDS 10
+#define MAX_CARDS 20 // What the 4 KB persist quota holds (see storage.c)
 #define MAX_NAME_LEN 32
+#define INDEX_NAME_LEN 20     // Menu copy of the name, truncated
+#define INDEX_SUBTITLE_LEN 16 // Description, or the format name when empty
+#define CARD_HASH_NONE 0      // Content hash unknown: the next sync re-sends the card
 // 1000 bytes of raw bits = 8000 pixels (enough for 88x88 matrix)
 #define MAX_BITS_LEN 1000 
+#if defined(PBL_PLATFORM_APLITE)
+#define CARD_CACHE_SLOTS 1 // Current card only: 24 KB of app RAM
+#else
+#define CARD_CACHE_SLOTS 3 // Current card plus its previous and next neighbours
+#endif
+#define DLIST_MAX_LEN MAX_BITS_LEN // Display lists share the cache slot buffer
+#define DLIST_VERSION 1
+#define EDGE_MAX_MODULES 160 // Widest drawable 1D code: 1px/module on a 180px screen less two quiet zones
 
 #define PERSIST_KEY_COUNT 500
 #define PERSIST_KEY_BASE 24200
@@ -18,36 +29,217 @@ typedef enum {
     FORMAT_EAN13 = 2,
     FORMAT_QR = 3,
     FORMAT_AZTEC = 4,   
-    FORMAT_PDF417 = 5   
+    FORMAT_PDF417 = 5,
+    FORMAT_UPCA = 6,
+    FORMAT_EAN8 = 7
 } BarcodeFormat;
 
+// How a card's data is stored (see barcodes.c). The phone picks per card
+// whichever is smaller of the pre-rendered modules and the source text, the
+// latter only for formats the watch can encode.
+typedef enum {
+    ENCODING_PACKED = 0,  // Continuous bit packing, MSB first
+    ENCODING_ROW_RLE = 1, // Repeated rows + white/black run lengths
+    ENCODING_TEXT = 2     // Source text, encoded on the watch (width/height 0)
+} CardEncoding;
+
 typedef struct {
     BarcodeFormat format;
     char name[MAX_NAME_LEN];
     char description[MAX_NAME_LEN]; 
     uint16_t width;
     uint16_t height;
+    uint8_t encoding; // CardEncoding; absent (0) in records written before it existed
 } WalletCardInfo;
 
+// When the app opens a card by itself at launch (KEY_QUICK_LAUNCH)
+typedef enum {
+    QUICK_LAUNCH_OFF = 0,
+    QUICK_LAUNCH_BUTTON = 1, // Launched from a Quick Launch button
+    QUICK_LAUNCH_ALWAYS = 2
+} QuickLaunchMode;
+
+// How often and how lately a card was opened, for the frecency order
+typedef struct {
+    uint16_t opens; // Saturates
+    uint16_t day;   // Of the last open, days since the epoch
+} CardUsage;
+
+// Where a card is stored; every card's is kept in RAM (see storage.c)
+typedef struct {
+    uint32_t hash;    // Content hash from the phone (delta sync)
+    uint8_t slot;     // Storage slot holding the card's records
+} CardRef;
+
+// Menu row for one card, paged in around the selection (storage_index_entry)
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    char name[INDEX_NAME_LEN];
+    char subtitle[INDEX_SUBTITLE_LEN];
+} CardIndexEntry;
+
+// Pre-rendered card compiled for one screen size (see barcodes.c)
+typedef struct {
+    uint8_t version;
+    uint8_t screen_w;
+    uint8_t screen_h;
+    uint8_t scale;
+    int16_t x_offset;
+    int16_t y_offset;
+    uint16_t rect_count;
+} DisplayListHeader;
+
+typedef struct {
+    uint8_t x, y, w, h;
+} DisplayRect;
+
+// Pixel position of each module of a 1D code on one screen (see barcodes.c)
+typedef struct {
+    uint8_t screen_w;
+    uint8_t screen_h;
+    uint16_t modules;  // 0: no table
+    int16_t origin;    // Module c covers [origin + edge[c], origin + edge[c + 1])
+    uint8_t edge[EDGE_MAX_MODULES + 1];
+} ModuleEdges;
+
+// What the detail window draws: packed module bits, or a display list
+typedef struct {
+    WalletCardInfo info; // Full info, loaded with the card
+    const uint8_t *data;
+    uint16_t len;
+    bool display_list;
+    ModuleEdges edges;   // 1D cards drawn from their bits or text
+} CardPayload;
+
 // --- Global State ---
-extern WalletCardInfo g_card_infos[MAX_CARDS];
+extern CardRef g_card_refs[MAX_CARDS];
 extern int g_card_count;
-extern uint8_t g_active_bits[MAX_BITS_LEN]; 
+extern const CardPayload *g_active_card; // Card shown in the detail window (card cache slot)
 extern bool g_invert_colors; 
+extern bool g_sort_by_use;     // Menu in frecency order instead of wallet order
+extern uint8_t g_quick_launch; // QuickLaunchMode
 
 // --- Modules ---
 void storage_load_settings(void);
 void storage_save_settings(void);
-void storage_load_card_data(int index, uint8_t *buffer, int max_len);
-void storage_save_card(int index, WalletCardInfo *info, const uint8_t *bits, int bits_len);
+int storage_load_card_data(int index, uint8_t *buffer, int max_len);
+bool storage_load_card_info(int index, WalletCardInfo *info);
+bool storage_save_card(int index, WalletCardInfo *info, const uint8_t *bits, int bits_len, uint32_t hash);
+int storage_apply_manifest(const uint32_t *hashes, int count, uint8_t *needed);
+void storage_flush_index(void);
+const CardIndexEntry *storage_index_entry(int index); // Valid until the next index call
 void storage_save_count(int count);
+void storage_truncate(int count);
+uint32_t storage_wallet_hash(void);
+void storage_record_open(int index);
+CardUsage storage_card_usage(int index);
+int storage_last_opened(void); // Card index, -1 when none
 void storage_clear_all(void);
 
+// Card Cache
+void card_cache_set_screen(GRect bounds);
+const CardPayload *card_cache_get(int index);
+void card_cache_prefetch(int index);
+bool card_cache_contains(int index);
+void card_cache_invalidate(int index);
+void card_cache_trim(void); // Frees all but the shown card's slot
+void card_cache_clear(void);
+
 // Barcode Renderer
-void barcode_draw(GContext *ctx, GRect bounds, BarcodeFormat format, uint16_t w, uint16_t h, const uint8_t *bits);
+void barcode_draw(GContext *ctx, GRect bounds, BarcodeFormat format, CardEncoding encoding,
+                  uint16_t w, uint16_t h, const uint8_t *bits, uint16_t len,
+                  const ModuleEdges *edges);
+bool barcode_build_edges(GRect bounds, BarcodeFormat format, CardEncoding encoding,
+                         uint16_t w, uint16_t h, const uint8_t *data, uint16_t len, ModuleEdges *out);
+bool barcode_invert(GContext *ctx, GRect bounds);
+
+// Display lists (barcodes.c, stored by storage.c). Not on aplite: its 1-bit
+// blit draws a card as fast as a list replays it, and compiling takes 2 KB
+// of heap its 24 KB of app RAM can't spare.
+#ifndef WALLET_DISPLAY_LISTS
+#if defined(PBL_PLATFORM_APLITE)
+#define WALLET_DISPLAY_LISTS 0
+#else
+#define WALLET_DISPLAY_LISTS 1
+#endif
+#endif
+
+#if WALLET_DISPLAY_LISTS
+int barcode_compile_display_list(GRect bounds, BarcodeFormat format, CardEncoding encoding,
+                                 uint16_t w, uint16_t h, const uint8_t *data, uint16_t len,
+                                 uint8_t *out, int max_len);
+bool barcode_display_list_pays(BarcodeFormat format);
+bool barcode_display_list_valid(const uint8_t *dlist, int len, GRect bounds);
+bool barcode_draw_display_list(GContext *ctx, GRect bounds, const uint8_t *dlist, int len);
+bool storage_save_display_list(int index, const uint8_t *dlist, int len);
+int storage_load_display_list(int index, uint8_t *buffer, int max_len);
+#endif
+
+// On-watch encoders for text cards (linear.c, gf.c, qr.c, aztec.c). Aplite's
+// 24 KB of app RAM, code included, can't hold them: the phone sends it
+// pre-rendered modules instead (watchCanEncode in pebble-js-app.js).
+#ifndef WALLET_TEXT_ENCODERS
+#if defined(PBL_PLATFORM_APLITE)
+#define WALLET_TEXT_ENCODERS 0
+#else
+#define WALLET_TEXT_ENCODERS 1
+#endif
+#endif
+
+#if WALLET_TEXT_ENCODERS
+// Linear Encoders (text to the packed one-row module stream the phone sends).
+// Returns the module count; 0 when the text doesn't encode, minus the count
+// when it needs more than max_modules (nothing written).
+int linear_encode(BarcodeFormat format, const char *text, int len, uint8_t *bits, int max_modules);
+
+// Galois Fields / Reed-Solomon (shared by the 2D generators)
+#define RS_MAX_DEGREE 76 // Aztec 27x27 check words; QR blocks need up to 30
+void gf_select(uint16_t poly);
+void rs_encode(const uint8_t *data, int len, uint8_t *ec, int degree, int first_root);
+
+// QR Code Generator (versions 1-10, so up to 57x57 modules)
+#define QR_PACKED_MAX_LEN ((57 * 57 + 7) / 8)
+bool qr_generate_packed(const char *data, int len, uint8_t *output_buffer, uint8_t *out_size);
+
+// Aztec Generator (compact, 1-4 layers, so up to 27x27 modules)
+#define AZTEC_PACKED_MAX_LEN ((27 * 27 + 7) / 8)
+bool aztec_generate_packed(const char *data, int len, uint8_t *output_buffer, uint8_t *out_size);
+#endif
+
+// Memory Probes: heap use and stack high-water mark around a piece of work,
+// logged in WALLET_DEBUG builds (pebble build -- --wallet-debug), compiled
+// out otherwise
+#if defined(WALLET_DEBUG)
+void mem_probe_begin(void);
+void mem_probe_end(const char *label);
+#define MEM_PROBE_BEGIN() mem_probe_begin()
+#define MEM_PROBE_END(label) mem_probe_end(label)
+#else
+#define MEM_PROBE_BEGIN() ((void)0)
+#define MEM_PROBE_END(label) ((void)0)
+#endif
 
-// QR Code Generator
-bool qr_generate_packed(const char *data, uint8_t *output_buffer, uint8_t *out_size);
+// Render Profiling: rolling load/draw times per format and redraws per
+// button press, shown on the detail window in WALLET_PROFILE builds
+// (pebble build -- --wallet-profile), compiled out otherwise
+#if defined(WALLET_PROFILE)
+typedef enum { PROFILE_LOAD, PROFILE_DRAW, PROFILE_KIND_COUNT } ProfileKind;
+uint32_t profile_now_ms(void);
+void profile_record(ProfileKind kind, BarcodeFormat format, uint32_t start_ms);
+void profile_button_pressed(void);
+void profile_draw_overlay(GContext *ctx, GRect bounds, BarcodeFormat format);
+#define PROFILE_START(var) uint32_t var = profile_now_ms()
+#define PROFILE_RECORD(kind, format, var) profile_record(kind, format, var)
+#define PROFILE_BUTTON() profile_button_pressed()
+#define PROFILE_OVERLAY(ctx, bounds, format) profile_draw_overlay(ctx, bounds, format)
+#else
+#define PROFILE_START(var) ((void)0)
+#define PROFILE_RECORD(kind, format, var) ((void)0)
+#define PROFILE_BUTTON() ((void)0)
+#define PROFILE_OVERLAY(ctx, bounds, format) ((void)0)
+#endif
 
 // UI
 void ui_push_main_menu(void);
@@ -0,0 +1,81 @@
+#include "common.h"
+#include <string.h>
+
+#if WALLET_TEXT_ENCODERS
+
+// ============================================================================
+// Galois Fields and Reed-Solomon
+// ============================================================================
+// GF(2^m), m <= 8, from its primitive polynomial: QR uses GF(256) (0x11D),
+// Aztec GF(16) for the mode message and GF(64)/GF(256) (0x43, 0x12D) for
+// data. One field's log/antilog tables are held at a time and rebuilt when
+// another polynomial is selected (255 steps).
+
+static uint8_t s_gf_exp[255];
+static uint8_t s_gf_log[256];
+static uint16_t s_gf_poly = 0;
+static int s_gf_order = 0; // 2^m - 1
+
+// The generator for `degree` EC words, prod (x - a^i) for first_root <= i <
+// first_root + degree, is kept in log form (GF_LOG_ZERO for a zero
+// coefficient), so encoding a block multiplies by adding logs.
+#define GF_LOG_ZERO 0xFF
+
+static uint8_t s_rs_gen_log[RS_MAX_DEGREE]; // log of x^(degree-1-i) coefficients
+static int s_rs_degree = 0;
+static int s_rs_first_root = 0;
+
+void gf_select(uint16_t poly) {
+    if (s_gf_poly == poly) return;
+    int size = 1;
+    while ((poly >> 1) >= size) size <<= 1;
+    s_gf_order = size - 1;
+
+    int x = 1;
+    for (int i = 0; i < s_gf_order; i++) {
+        s_gf_exp[i] = x;
+        s_gf_log[x] = i;
+        x <<= 1;
+        if (x & size) x ^= poly;
+    }
+    s_gf_log[0] = 0;
+    s_gf_poly = poly;
+    s_rs_degree = 0;
+}
+
+static inline uint8_t gf_mul_log(uint8_t a, int log_b) {
+    return a ? s_gf_exp[(s_gf_log[a] + log_b) % s_gf_order] : 0;
+}
+
+static void rs_build_generator(int degree, int first_root) {
+    if (s_rs_degree == degree && s_rs_first_root == first_root) return;
+    uint8_t gen[RS_MAX_DEGREE + 1] = {1}; // Monic, highest power first
+    for (int i = 0; i < degree; i++) {
+        // gen *= (x + a^(first_root + i))
+        for (int j = i + 1; j > 0; j--) gen[j] ^= gf_mul_log(gen[j - 1], first_root + i);
+    }
+    for (int i = 0; i < degree; i++) s_rs_gen_log[i] = gen[i + 1] ? s_gf_log[gen[i + 1]] : GF_LOG_ZERO;
+    s_rs_degree = degree;
+    s_rs_first_root = first_root;
+}
+
+// Systematic encoding in the selected field: `degree` EC words for `len`
+// data words
+void rs_encode(const uint8_t *data, int len, uint8_t *ec, int degree, int first_root) {
+    rs_build_generator(degree, first_root);
+    memset(ec, 0, degree);
+    for (int i = 0; i < len; i++) {
+        uint8_t factor = data[i] ^ ec[0];
+        memmove(ec, ec + 1, degree - 1);
+        ec[degree - 1] = 0;
+        if (factor == 0) continue;
+        int log_factor = s_gf_log[factor];
+        for (int j = 0; j < degree; j++) {
+            if (s_rs_gen_log[j] != GF_LOG_ZERO) {
+                ec[j] ^= s_gf_exp[(s_rs_gen_log[j] + log_factor) % s_gf_order];
+            }
+        }
+    }
+}
+
+#endif
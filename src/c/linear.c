@@ -0,0 +1,422 @@
+#include "common.h"
+#include <string.h>
+
+#if WALLET_TEXT_ENCODERS
+
+// ============================================================================
+// Linear (1D) Encoders
+// ============================================================================
+// Text to a one-row module stream, continuously bit-packed MSB first: the
+// same format as the bits the phone sends, so text cards go through the
+// same renderer, edge tables and display lists as pre-rendered ones.
+
+static int put_pattern(uint8_t *bits, int pos, const uint8_t *widths, int n) {
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < widths[i]; k++, pos++) {
+            if (i % 2 == 0) bits[pos >> 3] |= 0x80 >> (pos & 7);
+        }
+    }
+    return pos;
+}
+
+// ============================================================================
+// Code 128
+// ============================================================================
+
+static const uint8_t CODE128_PATTERNS[][6] = {
+    {2, 1, 2, 2, 2, 2}, // 0: Space
+    {2, 2, 2, 1, 2, 2}, // 1: !
+    {2, 2, 2, 2, 2, 1}, // 2: "
+    {1, 2, 1, 2, 2, 3}, // 3: #
+    {1, 2, 1, 3, 2, 2}, // 4: $
+    {1, 3, 1, 2, 2, 2}, // 5: %
+    {1, 2, 2, 2, 1, 3}, // 6: &
+    {1, 2, 2, 3, 1, 2}, // 7: '
+    {1, 3, 2, 2, 1, 2}, // 8: (
+    {2, 2, 1, 2, 1, 3}, // 9: )
+    {2, 2, 1, 3, 1, 2}, // 10: *
+    {2, 3, 1, 2, 1, 2}, // 11: +
+    {1, 1, 2, 2, 3, 2}, // 12: ,
+    {1, 2, 2, 1, 3, 2}, // 13: -
+    {1, 2, 2, 2, 3, 1}, // 14: .
+    {1, 1, 3, 2, 2, 2}, // 15: /
+    {1, 2, 3, 1, 2, 2}, // 16: 0
+    {1, 2, 3, 2, 2, 1}, // 17: 1
+    {2, 2, 3, 2, 1, 1}, // 18: 2
+    {2, 2, 1, 1, 3, 2}, // 19: 3
+    {2, 2, 1, 2, 3, 1}, // 20: 4
+    {2, 1, 3, 2, 1, 2}, // 21: 5
+    {2, 2, 3, 1, 1, 2}, // 22: 6
+    {3, 1, 2, 1, 3, 1}, // 23: 7
+    {3, 1, 1, 2, 2, 2}, // 24: 8
+    {3, 2, 1, 1, 2, 2}, // 25: 9
+    {3, 2, 1, 2, 2, 1}, // 26: :
+    {3, 1, 2, 2, 1, 2}, // 27: ;
+    {3, 2, 2, 1, 1, 2}, // 28: <
+    {3, 2, 2, 2, 1, 1}, // 29: =
+    {2, 1, 2, 1, 2, 3}, // 30: >
+    {2, 1, 2, 3, 2, 1}, // 31: ?
+    {2, 3, 2, 1, 2, 1}, // 32: @
+    {1, 1, 1, 3, 2, 3}, // 33: A
+    {1, 3, 1, 1, 2, 3}, // 34: B
+    {1, 3, 1, 3, 2, 1}, // 35: C
+    {1, 1, 2, 3, 1, 3}, // 36: D
+    {1, 3, 2, 1, 1, 3}, // 37: E
+    {1, 3, 2, 3, 1, 1}, // 38: F
+    {2, 1, 1, 3, 1, 3}, // 39: G
+    {2, 3, 1, 1, 1, 3}, // 40: H
+    {2, 3, 1, 3, 1, 1}, // 41: I
+    {1, 1, 2, 1, 3, 3}, // 42: J
+    {1, 1, 2, 3, 3, 1}, // 43: K
+    {1, 3, 2, 1, 3, 1}, // 44: L
+    {1, 1, 3, 1, 2, 3}, // 45: M
+    {1, 1, 3, 3, 2, 1}, // 46: N
+    {1, 3, 3, 1, 2, 1}, // 47: O
+    {3, 1, 3, 1, 2, 1}, // 48: P
+    {2, 1, 1, 3, 3, 1}, // 49: Q
+    {2, 3, 1, 1, 3, 1}, // 50: R
+    {2, 1, 3, 1, 1, 3}, // 51: S
+    {2, 1, 3, 3, 1, 1}, // 52: T
+    {2, 1, 3, 1, 3, 1}, // 53: U
+    {3, 1, 1, 1, 2, 3}, // 54: V
+    {3, 1, 1, 3, 2, 1}, // 55: W
+    {3, 3, 1, 1, 2, 1}, // 56: X
+    {3, 1, 2, 1, 1, 3}, // 57: Y
+    {3, 1, 2, 3, 1, 1}, // 58: Z
+    {3, 3, 2, 1, 1, 1}, // 59: [
+    {3, 1, 4, 1, 1, 1}, // 60: backslash
+    {2, 2, 1, 4, 1, 1}, // 61: ]
+    {4, 3, 1, 1, 1, 1}, // 62: ^
+    {1, 1, 1, 2, 2, 4}, // 63: _
+    {1, 1, 1, 4, 2, 2}, // 64: `
+    {1, 2, 1, 1, 2, 4}, // 65: a
+    {1, 2, 1, 4, 2, 1}, // 66: b
+    {1, 4, 1, 1, 2, 2}, // 67: c
+    {1, 4, 1, 2, 2, 1}, // 68: d
+    {1, 1, 2, 2, 1, 4}, // 69: e
+    {1, 1, 2, 4, 1, 2}, // 70: f
+    {1, 2, 2, 1, 1, 4}, // 71: g
+    {1, 2, 2, 4, 1, 1}, // 72: h
+    {1, 4, 2, 1, 1, 2}, // 73: i
+    {1, 4, 2, 2, 1, 1}, // 74: j
+    {2, 4, 1, 2, 1, 1}, // 75: k
+    {2, 2, 1, 1, 1, 4}, // 76: l
+    {4, 1, 3, 1, 1, 1}, // 77: m
+    {2, 4, 1, 1, 1, 2}, // 78: n
+    {1, 3, 4, 1, 1, 1}, // 79: o
+    {1, 1, 1, 2, 4, 2}, // 80: p
+    {1, 2, 1, 1, 4, 2}, // 81: q
+    {1, 2, 1, 2, 4, 1}, // 82: r
+    {1, 1, 4, 2, 1, 2}, // 83: s
+    {1, 2, 4, 1, 1, 2}, // 84: t
+    {1, 2, 4, 2, 1, 1}, // 85: u
+    {4, 1, 1, 2, 1, 2}, // 86: v
+    {4, 2, 1, 1, 1, 2}, // 87: w
+    {4, 2, 1, 2, 1, 1}, // 88: x
+    {2, 1, 2, 1, 4, 1}, // 89: y
+    {2, 1, 4, 1, 2, 1}, // 90: z
+    {4, 1, 2, 1, 2, 1}, // 91: {
+    {1, 1, 1, 1, 4, 3}, // 92: |
+    {1, 1, 1, 3, 4, 1}, // 93: }
+    {1, 3, 1, 1, 4, 1}, // 94: ~
+    {1, 1, 4, 1, 1, 3}, // 95: DEL
+    {1, 1, 4, 3, 1, 1}, // 96: FNC3
+    {4, 1, 1, 1, 1, 3}, // 97: FNC2
+    {4, 1, 1, 3, 1, 1}, // 98: SHIFT
+    {1, 1, 3, 1, 4, 1}, // 99: Code C
+    {1, 1, 4, 1, 3, 1}, // 100: Code B / FNC4
+    {3, 1, 1, 1, 4, 1}, // 101: Code A / FNC4
+    {4, 1, 1, 1, 3, 1}, // 102: FNC1
+    {2, 1, 1, 4, 1, 2}, // 103: Start A
+    {2, 1, 1, 2, 1, 4}, // 104: Start B
+    {2, 1, 1, 2, 3, 2}, // 105: Start C
+};
+
+static const uint8_t CODE128_STOP[] = {2, 3, 3, 1, 1, 1, 2};
+
+// Code sets, in the order of their start codes (103 + set)
+enum { SET_A = 0, SET_B = 1, SET_C = 2, SET_COUNT = 3 };
+
+#define C128_SHIFT 98
+#define C128_START 103
+// Switching to set s: Code A, Code B, Code C
+static const uint8_t C128_SWITCH[SET_COUNT] = {101, 100, 99};
+// FNC4 (next character + 128) in sets A and B
+static const uint8_t C128_FNC4[2] = {101, 100};
+
+// What the encoder does at one position in one set
+enum {
+    STEP_CHAR = 0,  // One character in the current set (after FNC4 if >= 128)
+    STEP_SHIFT = 1, // SHIFT, then one character from the other of A/B
+    STEP_PAIR = 2,  // Two digits in set C
+};
+
+#define C128_INF 0xFFFF
+
+// Plan per position and current set: the set used from there (a switch
+// when it differs) in the top bits, the step in the low two
+static uint8_t s_c128_plan[MAX_DATA_LEN + 1][SET_COUNT];
+
+static inline bool is_digit(uint8_t c) {
+    return c >= '0' && c <= '9';
+}
+
+// Value of character c (low 7 bits for extended ASCII) in set A or B, -1 if absent
+static int c128_value(uint8_t c, int set) {
+    c &= 0x7F;
+    if (set == SET_A) return (c < 32) ? c + 64 : (c < 96) ? c - 32 : -1;
+    return (c >= 32) ? c - 32 : -1;
+}
+
+// Symbols for character c in A or B: FNC4 first for extended ASCII
+static int c128_char_cost(uint8_t c, int set) {
+    if (c128_value(c, set) < 0) return C128_INF;
+    return (c >= 128) ? 2 : 1;
+}
+
+// Fewest symbols from position i onwards, starting in each set, given the
+// costs from i + 1 and i + 2. Switching to another set costs one symbol and
+// is only worth it right before using that set, so it is resolved last.
+static void c128_plan_step(const uint8_t *data, int len, int i,
+                           const uint16_t *next1, const uint16_t *next2, uint16_t *cost) {
+    uint8_t c = data[i];
+    uint16_t stay[SET_COUNT];
+    uint8_t step[SET_COUNT];
+    for (int s = SET_A; s <= SET_B; s++) {
+        uint32_t best = C128_INF;
+        step[s] = STEP_CHAR;
+        int own = c128_char_cost(c, s);
+        if (own < C128_INF && next1[s] < C128_INF) best = own + next1[s];
+        // SHIFT only for plain ASCII: FNC4 and SHIFT aren't combined
+        int other = c128_char_cost(c, 1 - s);
+        if (c < 128 && other < C128_INF && next1[s] < C128_INF && 1u + other + next1[s] < best) {
+            best = 1 + other + next1[s];
+            step[s] = STEP_SHIFT;
+        }
+        stay[s] = best;
+    }
+    stay[SET_C] = C128_INF;
+    step[SET_C] = STEP_PAIR;
+    if (i + 1 < len && is_digit(c) && is_digit(data[i + 1]) && next2[SET_C] < C128_INF) {
+        stay[SET_C] = 1 + next2[SET_C];
+    }
+
+    for (int s = 0; s < SET_COUNT; s++) {
+        int use = s;
+        uint32_t best = stay[s];
+        for (int t = 0; t < SET_COUNT; t++) {
+            if (t != s && stay[t] < C128_INF && 1u + stay[t] < best) {
+                best = 1 + stay[t];
+                use = t;
+            }
+        }
+        cost[s] = best;
+        s_c128_plan[i][s] = (use << 2) | step[use];
+    }
+}
+
+// Encodes `len` bytes of text as Code 128, choosing the shortest mix of
+// sets A, B and C with SHIFT and set switches (dynamic programming from the
+// end of the text). Bytes 128-255 use FNC4. Returns the module count, 0 if
+// the text is empty or too long, minus the count if it exceeds max_modules.
+static int code128_encode(const char *text, int len, uint8_t *bits, int max_modules) {
+    const uint8_t *data = (const uint8_t *)text;
+    if (len <= 0 || len > MAX_DATA_LEN) return 0;
+
+    // Costs at positions i + 1 and i + 2; the end of the text costs nothing
+    uint16_t next1[SET_COUNT] = {0, 0, 0}, next2[SET_COUNT] = {0, 0, 0}, cost[SET_COUNT];
+    for (int i = len - 1; i >= 0; i--) {
+        c128_plan_step(data, len, i, next1, next2, cost);
+        memcpy(next2, next1, sizeof(next1));
+        memcpy(next1, cost, sizeof(cost));
+    }
+
+    // Start in the cheapest set (B on ties, then C)
+    int set = SET_B;
+    if (next1[SET_C] < next1[set]) set = SET_C;
+    if (next1[SET_A] < next1[set]) set = SET_A;
+    if (next1[set] >= C128_INF) return 0;
+
+    int symbols = 1 + next1[set] + 1; // Start, data, checksum
+    int modules = symbols * 11 + 13;
+    if (modules > max_modules) return -modules;
+    memset(bits, 0, (modules + 7) / 8);
+
+    int checksum = C128_START + set;
+    int weight = 1;
+    int pos = put_pattern(bits, 0, CODE128_PATTERNS[C128_START + set], 6);
+    #define EMIT(v) do { int _v = (v); checksum += _v * weight++; \
+        pos = put_pattern(bits, pos, CODE128_PATTERNS[_v], 6); } while (0)
+
+    for (int i = 0; i < len;) {
+        uint8_t plan = s_c128_plan[i][set];
+        if ((plan >> 2) != set) {
+            set = plan >> 2;
+            EMIT(C128_SWITCH[set]);
+        }
+        uint8_t c = data[i];
+        switch (plan & 3) {
+            case STEP_PAIR:
+                EMIT((c - '0') * 10 + (data[i + 1] - '0'));
+                i += 2;
+                break;
+            case STEP_SHIFT:
+                EMIT(C128_SHIFT);
+                EMIT(c128_value(c, 1 - set));
+                i++;
+                break;
+            default:
+                if (c >= 128) EMIT(C128_FNC4[set]);
+                EMIT(c128_value(c, set));
+                i++;
+                break;
+        }
+    }
+    #undef EMIT
+
+    pos = put_pattern(bits, pos, CODE128_PATTERNS[checksum % 103], 6);
+    pos = put_pattern(bits, pos, CODE128_STOP, 7);
+    return pos;
+}
+
+// ============================================================================
+// EAN-13 / UPC-A / EAN-8
+// ============================================================================
+// Digits only; spaces and hyphens are skipped. The check digit is computed
+// when left out and must match when given. UPC-A is EAN-13 with a leading 0.
+
+// L-code digit patterns (7 modules, light first). G codes are the L codes
+// reversed, R codes the L codes inverted.
+static const uint8_t EAN_L[10] = {0x0D, 0x19, 0x13, 0x3D, 0x23, 0x31, 0x2F, 0x3B, 0x37, 0x0B};
+// EAN-13 first digit: which of the left six digits use G codes (bit 5 = first)
+static const uint8_t EAN_PARITY[10] = {0x00, 0x0B, 0x0D, 0x0E, 0x13, 0x19, 0x1C, 0x15, 0x16, 0x1A};
+
+static uint8_t reverse7(uint8_t v) {
+    uint8_t r = 0;
+    for (int i = 0; i < 7; i++) if (v & (1 << i)) r |= 0x40 >> i;
+    return r;
+}
+
+static int put_bits(uint8_t *bits, int pos, uint32_t value, int n) {
+    for (int i = n - 1; i >= 0; i--, pos++) {
+        if (value & (1u << i)) bits[pos >> 3] |= 0x80 >> (pos & 7);
+    }
+    return pos;
+}
+
+// Weights 3, 1, 3, ... from the digit next to the check digit
+static int ean_check_digit(const uint8_t *digits, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++) sum += digits[n - 1 - i] * ((i % 2 == 0) ? 3 : 1);
+    return (10 - sum % 10) % 10;
+}
+
+// `n` digits including the check digit into `digits`; false if the text
+// has other characters, the wrong length or a wrong check digit
+static bool ean_digits(const char *text, int len, int n, uint8_t *digits) {
+    int count = 0;
+    for (int i = 0; i < len; i++) {
+        char c = text[i];
+        if (c == ' ' || c == '-') continue;
+        if (!is_digit(c) || count == n) return false;
+        digits[count++] = c - '0';
+    }
+    if (count == n - 1) digits[count++] = ean_check_digit(digits, n - 1);
+    return count == n && digits[n - 1] == ean_check_digit(digits, n - 1);
+}
+
+// 13 digits (EAN-13) or 8 (EAN-8): guard, left half, centre, right half, guard
+static int ean_encode(const uint8_t *digits, int n, uint8_t *bits, int max_modules) {
+    int half = (n == 13) ? 6 : 4;
+    int modules = 3 + 2 * half * 7 + 5 + 3;
+    if (modules > max_modules) return -modules;
+    memset(bits, 0, (modules + 7) / 8);
+
+    const uint8_t *left = digits + (n == 13);
+    uint8_t parity = (n == 13) ? EAN_PARITY[digits[0]] : 0;
+    int pos = put_bits(bits, 0, 0x5, 3);
+    for (int i = 0; i < half; i++) {
+        uint8_t code = EAN_L[left[i]];
+        if (parity & (0x20 >> i)) code = reverse7(code ^ 0x7F);
+        pos = put_bits(bits, pos, code, 7);
+    }
+    pos = put_bits(bits, pos, 0x0A, 5);
+    for (int i = 0; i < half; i++) pos = put_bits(bits, pos, EAN_L[left[half + i]] ^ 0x7F, 7);
+    return put_bits(bits, pos, 0x5, 3);
+}
+
+// ============================================================================
+// Code 39
+// ============================================================================
+// Characters between '*' start/stop characters, wide elements 3 modules,
+// narrow 1, one narrow space between characters. Lowercase is uppercased;
+// no check character (it is optional and scanners don't expect it).
+
+#define CODE39_WIDE 3
+
+static const char CODE39_CHARS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-. $/+%*";
+// Wide elements, bar/space/bar/... from the first bar at bit 8
+static const uint16_t CODE39_PATTERNS[] = {
+    0x034, 0x121, 0x061, 0x160, 0x031, 0x130, 0x070, 0x025, 0x124, 0x064, // 0-9
+    0x109, 0x049, 0x148, 0x019, 0x118, 0x058, 0x00D, 0x10C, 0x04C, 0x01C, // A-J
+    0x103, 0x043, 0x142, 0x013, 0x112, 0x052, 0x007, 0x106, 0x046, 0x016, // K-T
+    0x181, 0x0C1, 0x1C0, 0x091, 0x190, 0x0D0,                             // U-Z
+    0x085, 0x184, 0x0C4, 0x0A8, 0x0A2, 0x08A, 0x02A, 0x094,               // - . space $ / + % *
+};
+
+static int code39_put_char(uint8_t *bits, int pos, uint16_t pattern) {
+    for (int i = 8; i >= 0; i--) {
+        int w = (pattern & (1 << i)) ? CODE39_WIDE : 1;
+        bool bar = (i % 2 == 0);
+        for (int k = 0; k < w; k++, pos++) {
+            if (bar) bits[pos >> 3] |= 0x80 >> (pos & 7);
+        }
+    }
+    return pos;
+}
+
+static int code39_encode(const char *text, int len, uint8_t *bits, int max_modules) {
+    if (len <= 0 || len > MAX_DATA_LEN) return 0;
+    uint8_t index[MAX_DATA_LEN];
+    for (int i = 0; i < len; i++) {
+        char c = text[i];
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        const char *p = (c && c != '*') ? strchr(CODE39_CHARS, c) : NULL;
+        if (!p) return 0;
+        index[i] = p - CODE39_CHARS;
+    }
+    int char_modules = 6 + 3 * CODE39_WIDE;
+    int modules = (len + 2) * (char_modules + 1) - 1;
+    if (modules > max_modules) return -modules;
+
+    memset(bits, 0, (modules + 7) / 8);
+    uint16_t star = CODE39_PATTERNS[sizeof(CODE39_CHARS) - 2];
+    int pos = code39_put_char(bits, 0, star) + 1;
+    for (int i = 0; i < len; i++) pos = code39_put_char(bits, pos, CODE39_PATTERNS[index[i]]) + 1;
+    return code39_put_char(bits, pos, star);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+int linear_encode(BarcodeFormat format, const char *text, int len, uint8_t *bits, int max_modules) {
+    uint8_t digits[13];
+    switch (format) {
+        case FORMAT_CODE128:
+            return code128_encode(text, len, bits, max_modules);
+        case FORMAT_CODE39:
+            return code39_encode(text, len, bits, max_modules);
+        case FORMAT_EAN13:
+            return ean_digits(text, len, 13, digits) ? ean_encode(digits, 13, bits, max_modules) : 0;
+        case FORMAT_UPCA:
+            digits[0] = 0;
+            return ean_digits(text, len, 12, digits + 1) ? ean_encode(digits, 13, bits, max_modules) : 0;
+        case FORMAT_EAN8:
+            return ean_digits(text, len, 8, digits) ? ean_encode(digits, 8, bits, max_modules) : 0;
+        default:
+            return 0;
+    }
+}
+
+#endif
@@ -1,23 +1,80 @@
 #include "common.h"
 
 // --- Global State ---
-WalletCardInfo g_card_infos[MAX_CARDS];
+CardRef g_card_refs[MAX_CARDS];
 int g_card_count = 0;
-uint8_t g_active_bits[MAX_BITS_LEN]; 
+const CardPayload *g_active_card = NULL;
 bool g_invert_colors = false;
+bool g_sort_by_use = false;
+uint8_t g_quick_launch = QUICK_LAUNCH_OFF;
 
 static Window *s_main_window;
 static MenuLayer *s_menu_layer;
 static Window *s_detail_window;
 static Layer *s_barcode_layer;
 static int s_current_index = 0;
+static int s_current_row = 0; // Menu row of s_current_index
 static bool s_loading = true;
 
+// Neighbours are prefetched one per idle tick after a card is shown
+#define PREFETCH_DELAY_MS 150
+static AppTimer *s_prefetch_timer = NULL;
+static int s_prefetch_step = 0;
+
+// The card index is written once the cards of a sync stop arriving
+#define INDEX_FLUSH_DELAY_MS 1000
+static AppTimer *s_index_flush_timer = NULL;
+
+// Inbox size asked for at startup; the phone sizes its chunks from it.
+// Aplite keeps a small inbox: its 24 KB hold the code as well as the heap.
+#if defined(PBL_BW)
+#define SYNC_INBOX_SIZE 512
+#else
+#define SYNC_INBOX_SIZE 2048
+#endif
+#define SYNC_MAX_CHUNKS 32
+static uint32_t s_inbox_size = 0;
+
+// Card arriving in CMD_SYNC_DATA chunks. Chunks may arrive out of order or
+// twice (a retransmit after a lost ACK); `received` has a bit per sequence.
+typedef struct {
+    uint8_t *data;
+    int index;
+    WalletCardInfo info;
+    uint32_t hash;
+    uint16_t len;
+    uint16_t chunk_size;
+    uint32_t received;
+    uint32_t complete;
+} ChunkedCard;
+static ChunkedCard s_rx = { .data = NULL };
+
+// Cards stored by this sync whose display list is still to be compiled
+static uint8_t s_dlist_pending[(MAX_CARDS + 7) / 8];
+
+// A card of this sync didn't fit in the persist quota: the wallet was cut
+// before it and the rest of the sync is ignored until the next one starts
+static bool s_storage_full = false;
+
 // --- AppMessage ---
+// The wallet hash lets the phone answer CMD_SYNC_UP_TO_DATE instead of
+// sending a manifest when nothing changed since the last sync.
 static void request_cards_from_phone(void *data) {
     DictionaryIterator *iter;
     if (app_message_outbox_begin(&iter) == APP_MSG_OK) {
         dict_write_uint8(iter, MESSAGE_KEY_CMD_FETCH_CONFIG, 1);
+        dict_write_uint32(iter, MESSAGE_KEY_KEY_INBOX_SIZE, s_inbox_size);
+        dict_write_uint32(iter, MESSAGE_KEY_KEY_WALLET_HASH, storage_wallet_hash());
+        app_message_outbox_send();
+    }
+}
+
+// The phone stops sending and expects the wallet hash of the first `stored`
+// cards, so the next launch doesn't retry a sync that can't fit
+static void report_storage_full(int stored) {
+    DictionaryIterator *iter;
+    if (app_message_outbox_begin(&iter) == APP_MSG_OK) {
+        dict_write_uint32(iter, MESSAGE_KEY_KEY_STORAGE_FULL, stored);
         app_message_outbox_send();
     }
 }
@@ -29,66 +86,370 @@ static void loading_timeout(void *data) {
     }
 }
 
-static void inbox_received_handler(DictionaryIterator *iter, void *context) {
-    if (dict_find(iter, MESSAGE_KEY_CMD_SYNC_START)) {
-        g_card_count = 0;
-        storage_save_count(0);
+static void flush_index(void *data) {
+    s_index_flush_timer = NULL;
+    storage_flush_index();
+}
+
+static void schedule_index_flush(void) {
+    if (s_index_flush_timer) app_timer_reschedule(s_index_flush_timer, INDEX_FLUSH_DELAY_MS);
+    else s_index_flush_timer = app_timer_register(INDEX_FLUSH_DELAY_MS, flush_index, NULL);
+}
+
+// Resolve the layout of the cards a sync stored, so the detail window only
+// replays rectangles. Lists are optional, so they are compiled once every
+// card of the sync is stored and never take quota a card needs. One is kept
+// only where replaying beats the blit (barcode_display_list_pays) and it is
+// smaller than the card's payload; other cards are drawn from their bits.
+// Aplite keeps none (WALLET_DISPLAY_LISTS).
+static void compile_display_lists(void) {
+#if WALLET_DISPLAY_LISTS
+    card_cache_trim();
+    uint8_t *bits = malloc(MAX_BITS_LEN);
+    uint8_t *dlist = malloc(DLIST_MAX_LEN);
+    GRect screen = layer_get_bounds(window_get_root_layer(s_main_window));
+    for (int i = 0; bits && dlist && i < g_card_count; i++) {
+        WalletCardInfo info;
+        if (!(s_dlist_pending[i / 8] & (1 << (i % 8))) || !storage_load_card_info(i, &info) ||
+            !barcode_display_list_pays(info.format)) continue;
+        int bits_len = storage_load_card_data(i, bits, MAX_BITS_LEN);
+        bool complete = (info.encoding != ENCODING_PACKED) || ((uint32_t)info.width * info.height + 7) / 8 <= (uint32_t)bits_len;
+        if (bits_len <= 0 || !complete) continue;
+        int len = barcode_compile_display_list(screen, info.format, info.encoding, info.width, info.height,
+                                               bits, bits_len, dlist, DLIST_MAX_LEN);
+        if (len > 0 && len < bits_len) storage_save_display_list(i, dlist, len);
+    }
+    free(bits);
+    free(dlist);
+#endif
+    memset(s_dlist_pending, 0, sizeof(s_dlist_pending));
+}
+
+// --- Menu Order ---
+// Menu row -> card index: wallet order, or frecency order with
+// g_sort_by_use. Recomputed at launch and when a sync changes the list,
+// never while browsing, so rows don't move under the selection. The detail
+// window flips through cards in menu order.
+static uint8_t s_menu_order[MAX_CARDS];
+
+// Opens weighted by how recent the last one was
+static uint32_t frecency(int index, int today) {
+    CardUsage u = storage_card_usage(index);
+    int age = today - u.day;
+    int weight = (age <= 4) ? 100 : (age <= 14) ? 70 : (age <= 31) ? 50 : (age <= 90) ? 30 : 10;
+    return (uint32_t)u.opens * weight;
+}
+
+static int menu_row_of(int index) {
+    for (int row = 0; row < g_card_count; row++) {
+        if (s_menu_order[row] == index) return row;
+    }
+    return 0;
+}
+
+static void menu_order_refresh(void) {
+    for (int i = 0; i < g_card_count; i++) s_menu_order[i] = i;
+    if (g_sort_by_use) {
+        // Insertion sort, stable: ties keep wallet order
+        int today = time(NULL) / SECONDS_PER_DAY;
+        for (int i = 1; i < g_card_count; i++) {
+            uint8_t card = s_menu_order[i];
+            uint32_t score = frecency(card, today);
+            int j = i;
+            while (j > 0 && frecency(s_menu_order[j - 1], today) < score) {
+                s_menu_order[j] = s_menu_order[j - 1];
+                j--;
+            }
+            s_menu_order[j] = card;
+        }
+    }
+    s_current_row = menu_row_of(s_current_index);
+}
+
+static void menu_refresh(void) {
+    menu_order_refresh();
+    menu_layer_reload_data(s_menu_layer);
+}
+
+// Card list changed under the detail window: show what is now at its index
+static void refresh_active_card(void) {
+    if (!s_barcode_layer) return;
+    g_active_card = (s_current_index < g_card_count) ? card_cache_get(s_current_index) : NULL;
+    layer_mark_dirty(s_barcode_layer);
+}
+
+// Delta sync: the phone sends the content hash of every card in order. Cards
+// the watch already has are kept (even if they moved); the reply lists the
+// indexes the phone still has to send as a bitmask.
+static void handle_manifest(Tuple *t_manifest) {
+    static uint32_t hashes[MAX_CARDS];
+    uint8_t needed[(MAX_CARDS + 7) / 8];
+    int count = t_manifest->length / sizeof(uint32_t);
+    if (count > MAX_CARDS) count = MAX_CARDS;
+    memcpy(hashes, t_manifest->value->data, count * sizeof(uint32_t));
+
+    card_cache_clear();
+    g_active_card = NULL;
+    if (storage_apply_manifest(hashes, count, needed) < 0) return;
+    refresh_active_card();
+
+    DictionaryIterator *iter;
+    if (app_message_outbox_begin(&iter) == APP_MSG_OK) {
+        dict_write_data(iter, MESSAGE_KEY_KEY_NEEDED, needed, (count + 7) / 8);
+        dict_write_uint32(iter, MESSAGE_KEY_KEY_INBOX_SIZE, s_inbox_size);
+        app_message_outbox_send();
+    }
+}
+
+static void read_card_info(DictionaryIterator *iter, Tuple *t_name, Tuple *t_fmt, WalletCardInfo *info) {
+    Tuple *t_desc = dict_find(iter, MESSAGE_KEY_KEY_DESCRIPTION);
+    Tuple *t_w = dict_find(iter, MESSAGE_KEY_KEY_WIDTH);
+    Tuple *t_h = dict_find(iter, MESSAGE_KEY_KEY_HEIGHT);
+    Tuple *t_enc = dict_find(iter, MESSAGE_KEY_KEY_ENCODING);
+
+    memset(info, 0, sizeof(*info));
+    strncpy(info->name, t_name->value->cstring, MAX_NAME_LEN-1);
+    strncpy(info->description, t_desc ? t_desc->value->cstring : "", MAX_NAME_LEN-1);
+    info->format = (BarcodeFormat)t_fmt->value->int32;
+    info->width = t_w ? t_w->value->int32 : 0;
+    info->height = t_h ? t_h->value->int32 : 0;
+    // Phones that predate KEY_ENCODING send text as a card without a size
+    if (t_enc) info->encoding = t_enc->value->int32;
+    else info->encoding = (info->width && info->height) ? ENCODING_PACKED : ENCODING_TEXT;
+}
+
+static void store_card(int i, WalletCardInfo *info, const uint8_t *data, int len, uint32_t hash) {
+    if (s_storage_full || i > g_card_count) return; // A sync restarted while the chunks were in flight
+    if (!storage_save_card(i, info, data, len, hash)) {
+        // Keep what fits as a prefix of the phone's wallet, so both sides agree on its hash
+        s_storage_full = true;
+        storage_truncate(i);
+        storage_flush_index();
+        card_cache_clear();
+        g_active_card = NULL;
+        refresh_active_card();
+        report_storage_full(i);
         s_loading = false;
-        
-        Tuple *t_inv = dict_find(iter, MESSAGE_KEY_KEY_INVERT);
-        if (t_inv) {
-            g_invert_colors = (t_inv->value->int32 == 1);
-            storage_save_settings();
+        menu_refresh();
+        return;
+    }
+    card_cache_invalidate(i);
+
+    if (i >= g_card_count) {
+        g_card_count = i + 1;
+        storage_save_count(g_card_count);
+    }
+    s_dlist_pending[i / 8] |= 1 << (i % 8);
+    schedule_index_flush();
+    if (s_barcode_layer && i == s_current_index) {
+        g_active_card = card_cache_get(i);
+        layer_mark_dirty(s_barcode_layer);
+    }
+    s_loading = false;
+    menu_refresh();
+}
+
+// ============================================================================
+// Chunked Transfer
+// ============================================================================
+// A card too big for one message arrives as a header (the card fields plus
+// KEY_DATA_LEN and KEY_CHUNK_SIZE, no KEY_DATA) followed by CMD_SYNC_DATA
+// chunks tagged with KEY_INDEX and KEY_SEQ. The phone keeps several chunks in
+// flight and resends only the ones that fail; the card is stored once every
+// sequence number has arrived.
+
+static void end_chunked_card(void) {
+    free(s_rx.data);
+    s_rx.data = NULL;
+}
+
+static void begin_chunked_card(int i, const WalletCardInfo *info, uint32_t hash, int len, DictionaryIterator *iter) {
+    end_chunked_card();
+    Tuple *t_size = dict_find(iter, MESSAGE_KEY_KEY_CHUNK_SIZE);
+    int chunk_size = t_size ? t_size->value->int32 : 0;
+    if (len <= 0 || len > MAX_BITS_LEN || chunk_size <= 0) return;
+    int chunks = (len + chunk_size - 1) / chunk_size;
+    if (chunks > SYNC_MAX_CHUNKS) return;
+
+    s_rx.data = malloc(len);
+    if (!s_rx.data) {
+        // Cached neighbours are the heap we can give back
+        card_cache_trim();
+        s_rx.data = malloc(len);
+    }
+    if (!s_rx.data) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "No memory for card %d", i);
+        return;
+    }
+    s_rx.index = i;
+    s_rx.info = *info;
+    s_rx.hash = hash;
+    s_rx.len = len;
+    s_rx.chunk_size = chunk_size;
+    s_rx.received = 0;
+    s_rx.complete = (chunks == SYNC_MAX_CHUNKS) ? 0xFFFFFFFF : ((1u << chunks) - 1);
+}
+
+static void handle_chunk(int i, DictionaryIterator *iter, Tuple *t_chunk) {
+    Tuple *t_seq = dict_find(iter, MESSAGE_KEY_KEY_SEQ);
+    if (!s_rx.data || i != s_rx.index || !t_seq) return; // Stale or duplicate after completion
+    int seq = t_seq->value->int32;
+    if (seq < 0 || seq >= SYNC_MAX_CHUNKS || !(s_rx.complete & (1u << seq))) return;
+
+    int offset = seq * s_rx.chunk_size;
+    int expected = s_rx.len - offset;
+    if (expected > s_rx.chunk_size) expected = s_rx.chunk_size;
+    if (t_chunk->length != expected) return;
+
+    memcpy(s_rx.data + offset, t_chunk->value->data, expected);
+    s_rx.received |= 1u << seq;
+    if (s_rx.received == s_rx.complete) {
+        store_card(s_rx.index, &s_rx.info, s_rx.data, s_rx.len, s_rx.hash);
+        end_chunked_card();
+    }
+}
+
+// Settings ride along with CMD_SYNC_MANIFEST and CMD_SYNC_START
+static void read_settings(DictionaryIterator *iter) {
+    Tuple *t_inv = dict_find(iter, MESSAGE_KEY_KEY_INVERT);
+    Tuple *t_sort = dict_find(iter, MESSAGE_KEY_KEY_SORT);
+    Tuple *t_quick = dict_find(iter, MESSAGE_KEY_KEY_QUICK_LAUNCH);
+    if (t_inv) g_invert_colors = (t_inv->value->int32 == 1);
+    if (t_sort) g_sort_by_use = (t_sort->value->int32 == 1);
+    if (t_quick && t_quick->value->int32 >= QUICK_LAUNCH_OFF && t_quick->value->int32 <= QUICK_LAUNCH_ALWAYS) {
+        g_quick_launch = t_quick->value->int32;
+    }
+    if (t_inv || t_sort || t_quick) storage_save_settings();
+}
+
+static void handle_sync_message(DictionaryIterator *iter) {
+    if (dict_find(iter, MESSAGE_KEY_CMD_SYNC_UP_TO_DATE)) {
+        // The stored cards are the phone's: show them (or "No cards") now
+        if (s_loading) {
+            s_loading = false;
+            menu_layer_reload_data(s_menu_layer);
         }
-        menu_layer_reload_data(s_menu_layer);
+        return;
+    }
+
+    Tuple *t_manifest = dict_find(iter, MESSAGE_KEY_CMD_SYNC_MANIFEST);
+    if (t_manifest) {
+        read_settings(iter);
+        end_chunked_card();
+        s_storage_full = false;
+        memset(s_dlist_pending, 0, sizeof(s_dlist_pending));
+        handle_manifest(t_manifest);
+        s_loading = false;
+        menu_refresh();
+    }
+
+    if (dict_find(iter, MESSAGE_KEY_CMD_SYNC_COMPLETE)) {
+        if (s_index_flush_timer) app_timer_cancel(s_index_flush_timer);
+        s_index_flush_timer = NULL;
+        storage_flush_index();
+        compile_display_lists();
+    }
+
+    if (dict_find(iter, MESSAGE_KEY_CMD_SYNC_START)) {
+        end_chunked_card();
+        s_storage_full = false;
+        memset(s_dlist_pending, 0, sizeof(s_dlist_pending));
+        card_cache_clear();
+        g_active_card = NULL;
+        storage_clear_all();
+        s_loading = false;
+        read_settings(iter);
+        menu_refresh();
     }
 
     Tuple *t_idx = dict_find(iter, MESSAGE_KEY_KEY_INDEX);
+    Tuple *t_chunk = dict_find(iter, MESSAGE_KEY_CMD_SYNC_DATA);
+    if (t_idx && t_chunk) {
+        handle_chunk(t_idx->value->int32, iter, t_chunk);
+        return;
+    }
+
     Tuple *t_name = dict_find(iter, MESSAGE_KEY_KEY_NAME);
     Tuple *t_data = dict_find(iter, MESSAGE_KEY_KEY_DATA);
+    Tuple *t_len = dict_find(iter, MESSAGE_KEY_KEY_DATA_LEN);
     Tuple *t_fmt = dict_find(iter, MESSAGE_KEY_KEY_FORMAT);
 
-    if (t_idx && t_name && t_data && t_fmt) {
+    if (t_idx && t_name && (t_data || t_len) && t_fmt) {
         int i = t_idx->value->int32;
-        if (i >= 0 && i < MAX_CARDS) {
-            Tuple *t_desc = dict_find(iter, MESSAGE_KEY_KEY_DESCRIPTION);
-            Tuple *t_w = dict_find(iter, MESSAGE_KEY_KEY_WIDTH);
-            Tuple *t_h = dict_find(iter, MESSAGE_KEY_KEY_HEIGHT);
-
-            strncpy(g_card_infos[i].name, t_name->value->cstring, MAX_NAME_LEN-1);
-            strncpy(g_card_infos[i].description, t_desc ? t_desc->value->cstring : "", MAX_NAME_LEN-1);
-            g_card_infos[i].format = (BarcodeFormat)t_fmt->value->int32;
-            g_card_infos[i].width = t_w ? t_w->value->int32 : 0;
-            g_card_infos[i].height = t_h ? t_h->value->int32 : 0;
-            
-            storage_save_card(i, &g_card_infos[i], t_data->value->data, t_data->length);
-            
-            if (i >= g_card_count) {
-                g_card_count = i + 1;
-                storage_save_count(g_card_count);
-            }
-            s_loading = false;
-            menu_layer_reload_data(s_menu_layer);
+        // Cards arrive in order after CMD_SYNC_START, or replace a manifest entry
+        if (i >= 0 && i < MAX_CARDS && i <= g_card_count && !s_storage_full) {
+            Tuple *t_hash = dict_find(iter, MESSAGE_KEY_KEY_HASH);
+            uint32_t hash = t_hash ? (uint32_t)t_hash->value->int32 : CARD_HASH_NONE;
+            WalletCardInfo info;
+            read_card_info(iter, t_name, t_fmt, &info);
+
+            if (t_data) store_card(i, &info, t_data->value->data, t_data->length, hash);
+            else begin_chunked_card(i, &info, hash, t_len->value->int32, iter);
         }
     }
 }
 
+static void inbox_received_handler(DictionaryIterator *iter, void *context) {
+    MEM_PROBE_BEGIN();
+    handle_sync_message(iter);
+    MEM_PROBE_END("sync");
+}
+
 static void barcode_update_proc(Layer *layer, GContext *ctx) {
-    if (s_current_index >= 0 && s_current_index < g_card_count) {
-        WalletCardInfo *info = &g_card_infos[s_current_index];
+    if (g_active_card && s_current_index >= 0 && s_current_index < g_card_count) {
+        const WalletCardInfo *info = &g_active_card->info;
         GRect bounds = layer_get_bounds(layer);
-        barcode_draw(ctx, bounds, info->format, info->width, info->height, g_active_bits);
+        PROFILE_START(draw_start);
+        MEM_PROBE_BEGIN();
+#if WALLET_DISPLAY_LISTS
+        if (!g_active_card->display_list ||
+            !barcode_draw_display_list(ctx, bounds, g_active_card->data, g_active_card->len))
+#endif
+        {
+            bool has_bits = !g_active_card->display_list && g_active_card->len > 0;
+            barcode_draw(ctx, bounds, info->format, info->encoding, info->width, info->height,
+                         has_bits ? g_active_card->data : NULL, g_active_card->len, &g_active_card->edges);
+        }
+        // Drawn black on white either way; without a framebuffer it stays so
+        if (g_invert_colors) barcode_invert(ctx, bounds);
+        MEM_PROBE_END("draw");
+        PROFILE_RECORD(PROFILE_DRAW, info->format, draw_start);
+        PROFILE_OVERLAY(ctx, bounds, info->format);
+    } else if (s_current_index >= 0 && s_current_index < g_card_count) {
+        // No heap for a cache slot
+        graphics_context_set_text_color(ctx, GColorBlack);
+        graphics_draw_text(ctx, "Not enough memory", fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
+                           layer_get_bounds(layer), GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
     }
 }
 
+static void prefetch_neighbors(void *data) {
+    s_prefetch_timer = NULL;
+    if (g_card_count <= 1) return;
+
+    // Next card first: DOWN is the usual direction at the till
+    int offset = (s_prefetch_step == 0) ? 1 : -1;
+    card_cache_prefetch(s_menu_order[(s_current_row + offset + g_card_count) % g_card_count]);
+    if (++s_prefetch_step < 2) s_prefetch_timer = app_timer_register(PREFETCH_DELAY_MS, prefetch_neighbors, NULL);
+}
+
+static void schedule_prefetch(void) {
+    if (s_prefetch_timer) app_timer_cancel(s_prefetch_timer);
+    s_prefetch_step = 0;
+    s_prefetch_timer = app_timer_register(PREFETCH_DELAY_MS, prefetch_neighbors, NULL);
+}
+
 static void detail_click_handler(ClickRecognizerRef recognizer, void *context) {
     if (g_card_count <= 1) return;
+    PROFILE_BUTTON();
     ButtonId btn = click_recognizer_get_button_id(recognizer);
-    if (btn == BUTTON_ID_DOWN) s_current_index = (s_current_index + 1) % g_card_count;
-    else if (btn == BUTTON_ID_UP) s_current_index = (s_current_index - 1 + g_card_count) % g_card_count;
+    if (btn == BUTTON_ID_DOWN) s_current_row = (s_current_row + 1) % g_card_count;
+    else if (btn == BUTTON_ID_UP) s_current_row = (s_current_row - 1 + g_card_count) % g_card_count;
+    s_current_index = s_menu_order[s_current_row];
     
-    storage_load_card_data(s_current_index, g_active_bits, MAX_BITS_LEN);
+    g_active_card = card_cache_get(s_current_index);
     layer_mark_dirty(s_barcode_layer);
+    schedule_prefetch();
 }
 
 static void detail_config_provider(void *ctx) {
@@ -103,22 +464,40 @@ static void detail_window_load(Window *window) {
     layer_add_child(root, s_barcode_layer);
 }
 
+// The card the user leaves the detail window on counts as opened
 static void detail_window_unload(Window *window) {
+    storage_record_open(s_current_index);
+    if (g_card_count > 0) {
+        menu_layer_set_selected_index(s_menu_layer, (MenuIndex){ .section = 0, .row = s_current_row },
+                                      MenuRowAlignCenter, false);
+    }
+    if (s_prefetch_timer) {
+        app_timer_cancel(s_prefetch_timer);
+        s_prefetch_timer = NULL;
+    }
     layer_destroy(s_barcode_layer);
+    s_barcode_layer = NULL;
 }
 
-void ui_push_card_detail(int index) {
+static void push_card_detail(int index, bool animated) {
+    PROFILE_BUTTON();
     s_current_index = index;
-    storage_load_card_data(index, g_active_bits, MAX_BITS_LEN);
+    s_current_row = menu_row_of(index);
+    g_active_card = card_cache_get(index);
+    schedule_prefetch();
     if (!s_detail_window) {
         s_detail_window = window_create();
         window_set_window_handlers(s_detail_window, (WindowHandlers){ .load = detail_window_load, .unload = detail_window_unload });
         window_set_click_config_provider(s_detail_window, detail_config_provider);
     }
-    window_stack_push(s_detail_window, true);
+    window_stack_push(s_detail_window, animated);
     light_enable(true); 
 }
 
+void ui_push_card_detail(int index) {
+    push_card_detail(index, true);
+}
+
 static uint16_t menu_get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *data) {
     if (s_loading) return 1;
     return (g_card_count > 0) ? g_card_count : 1;
@@ -142,26 +521,15 @@ static void menu_draw_row(GContext *ctx, const Layer *cell_layer, MenuIndex *cel
     if (g_card_count == 0) {
         menu_cell_basic_draw(ctx, cell_layer, "No Cards", "Add via Settings", NULL);
     } else {
-        WalletCardInfo *c = &g_card_infos[cell_index->row];
-        
-        // Use menu_cell_basic_draw to handle selection highlight (inverted text) automatically
-        const char *subtitle;
-        char fmt_subtitle[MAX_NAME_LEN];
-        if (strlen(c->description) > 0) {
-            subtitle = c->description;
-        } else {
-            static const char *names[] = {"Code 128", "Code 39", "EAN-13", "QR Code", "Aztec", "PDF417"};
-            int fi = (int)c->format;
-            if (fi >= 0 && fi <= 5) snprintf(fmt_subtitle, sizeof(fmt_subtitle), "%s", names[fi]);
-            else snprintf(fmt_subtitle, sizeof(fmt_subtitle), "Barcode");
-            subtitle = fmt_subtitle;
-        }
-        menu_cell_basic_draw(ctx, cell_layer, c->name, subtitle, NULL);
+        // Use menu_cell_basic_draw to handle selection highlight (inverted text) automatically.
+        // Rows are paged in from storage around the selection.
+        const CardIndexEntry *c = (cell_index->row < g_card_count) ? storage_index_entry(s_menu_order[cell_index->row]) : NULL;
+        if (c) menu_cell_basic_draw(ctx, cell_layer, c->name, c->subtitle, NULL);
     }
 }
 
 static void menu_select(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
-    if (!s_loading && g_card_count > 0) ui_push_card_detail(cell_index->row);
+    if (!s_loading && cell_index->row < g_card_count) ui_push_card_detail(s_menu_order[cell_index->row]);
 }
 
 static void main_window_load(Window *window) {
@@ -175,21 +543,38 @@ static void main_window_load(Window *window) {
     });
     menu_layer_set_click_config_onto_window(s_menu_layer, window);
     layer_add_child(root, menu_layer_get_layer(s_menu_layer));
+    card_cache_set_screen(layer_get_bounds(root));
 }
 
 static void main_window_unload(Window *window) {
     menu_layer_destroy(s_menu_layer);
 }
 
+// Quick launch: the card opened last, straight away
+static int quick_launch_card(void) {
+    bool wanted = (g_quick_launch == QUICK_LAUNCH_ALWAYS) ||
+                  (g_quick_launch == QUICK_LAUNCH_BUTTON && launch_reason() == APP_LAUNCH_QUICK_LAUNCH);
+    return wanted ? storage_last_opened() : -1;
+}
+
 static void init(void) {
     storage_load_settings();
     if (g_card_count > 0) s_loading = false;
+    menu_order_refresh();
+    int quick = quick_launch_card();
     
     app_message_register_inbox_received(inbox_received_handler);
-    app_message_open(2048, 256);
+    s_inbox_size = app_message_inbox_size_maximum();
+    if (s_inbox_size > SYNC_INBOX_SIZE) s_inbox_size = SYNC_INBOX_SIZE;
+    app_message_open(s_inbox_size, 256);
     s_main_window = window_create();
     window_set_window_handlers(s_main_window, (WindowHandlers){ .load = main_window_load, .unload = main_window_unload });
-    window_stack_push(s_main_window, true);
+    window_stack_push(s_main_window, quick < 0);
+    if (quick >= 0) {
+        // Loaded here, so the detail window's first frame draws from the cache;
+        // no animation, so that frame is the only one
+        push_card_detail(quick, false);
+    }
 
     // Proactive request and timeout
     app_timer_register(500, request_cards_from_phone, NULL);
@@ -199,12 +584,19 @@ static void init(void) {
 }
 
 static void deinit(void) {
-    window_destroy(s_main_window);
+    if (s_index_flush_timer) app_timer_cancel(s_index_flush_timer);
+    end_chunked_card();
+    // Detail first: its unload records the open and selects the menu row
     if (s_detail_window) window_destroy(s_detail_window);
+    window_destroy(s_main_window);
+    card_cache_clear();
+    storage_flush_index();
 }
 
 int main(void) {
+    MEM_PROBE_BEGIN();
     init();
+    MEM_PROBE_END("init");
     app_event_loop();
     deinit();
 }
\ No newline at end of file
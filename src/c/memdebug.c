@@ -0,0 +1,87 @@
+#include "common.h"
+
+// ============================================================================
+// Memory Probes (WALLET_DEBUG builds)
+// ============================================================================
+// Logs heap use and the stack high-water mark around a piece of work:
+//
+//   MEM_PROBE_BEGIN();
+//   barcode_draw(...);
+//   MEM_PROBE_END("draw");
+//
+// BEGIN paints the stack below the probe with a canary byte; END finds the
+// deepest byte that no longer holds it. The paint is a local array of a
+// helper called at the probe's depth, so live frames are never touched.
+// Probes nest: an inner BEGIN first collects what the outer probe has seen
+// (its repaint would hide it), and an inner END hands its depth back.
+//
+// Only MEM_STACK_PAINT_BYTES below the probe are watched; deeper use is
+// logged as ">=". Keep it below the free stack at the outermost probe site
+// (aplite apps have a few KB of stack).
+//
+// Build with `pebble build -- --wallet-debug`; other builds compile the
+// probes out (see common.h).
+
+#if defined(WALLET_DEBUG)
+
+#ifndef MEM_STACK_PAINT_BYTES
+#define MEM_STACK_PAINT_BYTES 1024
+#endif
+#define MEM_CANARY 0xA5
+#define MEM_MAX_NESTING 4
+
+typedef struct {
+    uintptr_t sp;     // About the stack pointer of the probe's caller
+    uintptr_t bottom; // Lowest painted address
+    uintptr_t low;    // Deepest address found in use so far
+    int heap_used;    // At BEGIN
+} MemProbe;
+
+static MemProbe s_probes[MEM_MAX_NESTING];
+static int s_nesting = 0;
+
+static __attribute__((noinline)) uintptr_t stack_paint(void) {
+    volatile uint8_t area[MEM_STACK_PAINT_BYTES];
+    for (int i = 0; i < MEM_STACK_PAINT_BYTES; i++) area[i] = MEM_CANARY;
+    return (uintptr_t)area;
+}
+
+// Lowest address above `bottom` that no longer holds the canary
+static __attribute__((noinline)) uintptr_t stack_scan(uintptr_t bottom) {
+    const volatile uint8_t *p = (const volatile uint8_t *)bottom;
+    int i = 0;
+    while (i < MEM_STACK_PAINT_BYTES && p[i] == MEM_CANARY) i++;
+    return bottom + i;
+}
+
+static void probe_collect(MemProbe *p) {
+    uintptr_t low = stack_scan(p->bottom);
+    if (low < p->low) p->low = low;
+}
+
+void mem_probe_begin(void) {
+    if (s_nesting > 0 && s_nesting <= MEM_MAX_NESTING) probe_collect(&s_probes[s_nesting - 1]);
+    if (s_nesting++ >= MEM_MAX_NESTING) return; // Too deep: not measured
+
+    MemProbe *p = &s_probes[s_nesting - 1];
+    p->sp = (uintptr_t)__builtin_frame_address(0);
+    p->heap_used = (int)heap_bytes_used();
+    p->bottom = stack_paint();
+    p->low = p->sp;
+}
+
+void mem_probe_end(const char *label) {
+    if (s_nesting == 0) return;
+    if (--s_nesting >= MEM_MAX_NESTING) return;
+
+    MemProbe *p = &s_probes[s_nesting];
+    probe_collect(p);
+    if (s_nesting > 0 && p->low < s_probes[s_nesting - 1].low) s_probes[s_nesting - 1].low = p->low;
+
+    int heap_used = (int)heap_bytes_used();
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "mem %s: stack %s%d B, heap used %d (delta %d), free %d",
+            label, (p->low == p->bottom) ? ">=" : "", (int)(p->sp - p->low),
+            heap_used, heap_used - p->heap_used, (int)heap_bytes_free());
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "common.h"
+
+// ============================================================================
+// Render Profiling (WALLET_PROFILE builds)
+// ============================================================================
+// Card loads (storage reads and edge tables, card_cache.c) and barcode layer
+// draws (main.c) are timed with time_ms and kept per format over the last
+// PROFILE_WINDOW samples. Redraws are counted per button press: a press
+// that repaints more than once is wasted work. The detail window shows the
+// numbers for the current card's format in a strip at the bottom, and every
+// draw is logged.
+//
+// Build with `pebble build -- --wallet-profile`; other builds compile the
+// hooks out (see common.h).
+
+#if defined(WALLET_PROFILE)
+
+#define PROFILE_WINDOW 16
+#define PROFILE_FORMATS 8 // BarcodeFormat values
+#define OVERLAY_H 16
+
+typedef struct {
+    uint16_t samples[PROFILE_WINDOW]; // ms
+    uint8_t count;                    // Samples held, up to PROFILE_WINDOW
+    uint8_t next;
+} ProfileSeries;
+
+typedef struct {
+    int min, avg, max; // ms; count 0 when there are no samples
+    int count;
+} ProfileStats;
+
+static ProfileSeries s_series[PROFILE_KIND_COUNT][PROFILE_FORMATS];
+static uint16_t s_press_redraws = 0; // Since the last button press
+static uint16_t s_max_press_redraws = 0;
+
+static const char *const KIND_NAMES[PROFILE_KIND_COUNT] = { "load", "draw" };
+
+uint32_t profile_now_ms(void) {
+    time_t s;
+    uint16_t ms;
+    time_ms(&s, &ms);
+    return (uint32_t)s * 1000 + ms;
+}
+
+static void series_stats(const ProfileSeries *series, ProfileStats *out) {
+    out->count = series->count;
+    out->min = out->avg = out->max = 0;
+    if (!series->count) return;
+    int sum = 0;
+    out->min = 0xFFFF;
+    for (int i = 0; i < series->count; i++) {
+        int v = series->samples[i];
+        sum += v;
+        if (v < out->min) out->min = v;
+        if (v > out->max) out->max = v;
+    }
+    out->avg = sum / series->count;
+}
+
+void profile_record(ProfileKind kind, BarcodeFormat format, uint32_t start_ms) {
+    if ((unsigned)format >= PROFILE_FORMATS) return;
+    uint32_t elapsed = profile_now_ms() - start_ms;
+    ProfileSeries *series = &s_series[kind][format];
+    series->samples[series->next] = (elapsed > 0xFFFF) ? 0xFFFF : elapsed;
+    series->next = (series->next + 1) % PROFILE_WINDOW;
+    if (series->count < PROFILE_WINDOW) series->count++;
+
+    if (kind == PROFILE_DRAW) {
+        s_press_redraws++;
+        if (s_press_redraws > s_max_press_redraws) s_max_press_redraws = s_press_redraws;
+    }
+
+    ProfileStats st;
+    series_stats(series, &st);
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "%s format %d: %d ms (min %d avg %d max %d of %d)",
+            KIND_NAMES[kind], (int)format, (int)elapsed, st.min, st.avg, st.max, st.count);
+}
+
+void profile_button_pressed(void) {
+    s_press_redraws = 0;
+}
+
+void profile_draw_overlay(GContext *ctx, GRect bounds, BarcodeFormat format) {
+    if ((unsigned)format >= PROFILE_FORMATS) return;
+    ProfileStats draw, load;
+    series_stats(&s_series[PROFILE_DRAW][format], &draw);
+    series_stats(&s_series[PROFILE_LOAD][format], &load);
+
+    // draw min/avg/max, load min/avg/max, redraws this press (most seen)
+    char text[48];
+    snprintf(text, sizeof(text), "D%d/%d/%d L%d/%d/%d R%d(%d)",
+             draw.min, draw.avg, draw.max, load.min, load.avg, load.max,
+             s_press_redraws, s_max_press_redraws);
+
+#if defined(PBL_ROUND)
+    GRect strip = GRect(bounds.origin.x, bounds.origin.y + bounds.size.h - OVERLAY_H - 24, bounds.size.w, OVERLAY_H);
+#else
+    GRect strip = GRect(bounds.origin.x, bounds.origin.y + bounds.size.h - OVERLAY_H, bounds.size.w, OVERLAY_H);
+#endif
+    graphics_context_set_fill_color(ctx, GColorWhite);
+    graphics_fill_rect(ctx, strip, 0, GCornerNone);
+    graphics_context_set_text_color(ctx, GColorBlack);
+    graphics_draw_text(ctx, text, fonts_get_system_font(FONT_KEY_GOTHIC_14), strip,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+}
+
+#endif
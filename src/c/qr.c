@@ -1,17 +1,46 @@
 #include "common.h"
 #include <string.h>
+#include <limits.h>
+
+#if WALLET_TEXT_ENCODERS
 
 // ============================================================================
 // GEMINI OPTIMIZED QR GENERATOR
 // ============================================================================
 // Features:
-// - Static memory allocation (Safe for Aplite)
+// - Working memory (codewords, matrix planes) heap-allocated only while
+//   generating, so nothing stays resident on Aplite
 // - No large stack buffers
 // - Generates bit-packed output directly
+// - Versions 1-10 at EC level L, numeric / alphanumeric / byte mode (the
+//   narrowest mode that covers the whole input), smallest version that fits
+// - Mask chosen from all 8 by the standard penalty score
+
+#define QR_MAX_VERSION 10
+#define QR_MAX_SIZE (17 + 4 * QR_MAX_VERSION)
+#define QR_MAX_DATA_CW 274 // v10-L
+#define QR_MAX_EC_CW 72    // v10-L: 4 blocks x 18
+#define QR_GF_POLY 0x11D // GF(256), RS generator roots a^0, a^1, ...
+
+// The matrix is two bit planes, one 64-bit word per row, column c at bit
+// 63 - c (MSB first, like the packed output). `reserved` marks function
+// patterns, format/version areas and columns past the edge; `modules` holds
+// dark modules. Masking is then a few word operations per row.
+typedef uint64_t QrRow;
+
+#define QR_BIT(c) ((QrRow)1 << (63 - (c)))
 
-#define QR_MAX_SIZE 33
-// 33x33 matrix needs ~1KB. We put this in BSS (static) to save stack.
-static int8_t s_qr_matrix[QR_MAX_SIZE][QR_MAX_SIZE]; 
+// Working memory of one qr_generate_packed call (about 2KB at v10),
+// malloc'd for the call: generation runs once per sync or text change.
+typedef struct {
+    QrRow modules[QR_MAX_SIZE];
+    QrRow reserved[QR_MAX_SIZE];
+    QrRow scratch[QR_MAX_SIZE]; // Masked rows while scoring
+    // Codewords: data, then each block's EC, then both interleaved for placement
+    uint8_t data_cw[QR_MAX_DATA_CW];
+    uint8_t ec_cw[QR_MAX_EC_CW];
+    uint8_t all_cw[QR_MAX_DATA_CW + QR_MAX_EC_CW];
+} QrWork;
 
 // Tables and constants for QR generation
 static const uint8_t ALPHANUM_MAP[128] = {
@@ -25,24 +54,45 @@ static const uint8_t ALPHANUM_MAP[128] = {
     255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
 };
 
-// GF(256) Math Tables
-static const uint8_t GF_EXP[256] = {1,2,4,8,16,32,64,128,29,58,116,232,205,135,19,38,76,152,45,90,180,117,234,201,143,3,6,12,24,48,96,192,157,39,78,156,37,74,148,53,106,212,181,119,238,193,159,35,70,140,5,10,20,40,80,160,93,186,105,210,185,111,222,161,95,190,97,194,153,47,94,188,101,202,137,15,30,60,120,240,253,231,211,187,107,214,177,127,254,225,223,163,91,182,113,226,217,175,67,134,17,34,68,136,13,26,52,104,208,189,103,206,129,31,62,124,248,237,199,147,59,118,236,197,151,51,102,204,133,23,46,92,184,109,218,169,79,158,33,66,132,21,42,84,168,77,154,41,82,164,85,170,73,146,57,114,228,213,183,115,230,209,191,99,198,145,63,126,252,229,215,179,123,246,241,255,227,219,171,75,150,49,98,196,149,55,110,220,165,87,174,65,130,25,50,100,200,141,7,14,28,56,112,224,221,167,83,166,81,162,89,178,121,242,249,239,195,155,43,86,172,69,138,9,18,36,72,144,61,122,244,245,247,243,251,235,203,139,11,22,44,88,176,125,250,233,207,131,27,54,108,216,173,71,142,1};
-static const uint8_t GF_LOG[256] = {0,0,1,25,2,50,26,198,3,223,51,238,27,104,199,75,4,100,224,14,52,141,239,129,28,193,105,248,200,8,76,113,5,138,101,47,225,36,15,33,53,147,142,218,240,18,130,69,29,181,194,125,106,39,249,185,201,154,9,120,77,228,114,166,6,191,139,98,102,221,48,253,226,152,37,179,16,145,34,136,54,208,148,206,143,150,219,189,241,210,19,92,131,56,70,64,30,66,182,163,195,72,126,110,107,58,40,84,250,133,186,61,202,94,155,159,10,21,121,43,78,212,229,172,115,243,167,87,7,112,192,247,140,128,99,13,103,74,222,237,49,197,254,24,227,165,153,119,38,184,180,124,17,68,146,217,35,32,137,46,55,63,209,91,149,188,207,205,144,135,151,178,220,252,190,97,242,86,211,171,20,42,93,158,132,60,57,83,71,109,65,162,31,45,67,216,183,123,164,118,196,23,73,236,127,12,111,246,108,161,59,82,41,157,85,170,251,96,134,177,187,204,62,90,203,89,95,176,156,169,160,81,11,245,22,235,122,117,44,215,79,174,213,233,230,231,173,232,116,214,244,234,168,80,88,175};
+// EC level L. Blocks: `blocks_1` of `data_1` data codewords, then
+// `blocks_2` of data_1 + 1. Every block gets `ec` EC codewords.
+typedef struct {
+    uint8_t ec;
+    uint8_t blocks_1;
+    uint8_t data_1;
+    uint8_t blocks_2;
+    uint8_t align[3]; // Alignment pattern centres (0 = none)
+} QrVersion;
 
-static const uint8_t RS_GEN_V1[] = {1, 127, 122, 154, 164, 11, 68, 117};
-static const uint8_t RS_GEN_V2[] = {1, 216, 194, 159, 111, 199, 94, 95, 113, 157, 193};
-static const uint8_t RS_GEN_V3[] = {1, 29, 196, 111, 163, 112, 74, 10, 105, 105, 139, 132, 151, 32, 134, 26};
-static const uint8_t RS_GEN_V4[] = {1, 152, 185, 240, 5, 111, 99, 6, 220, 112, 150, 69, 36, 187, 22, 228, 198, 121, 121, 165, 174};
-static const uint8_t *RS_GENERATORS[] = {RS_GEN_V1, RS_GEN_V2, RS_GEN_V3, RS_GEN_V4};
-
-// {size, data_cw, ec_cw, alpha_cap}
-static const struct { uint8_t size, data_cw, ec_cw, alpha_cap; } VERSIONS[4] = {
-    {21, 19,  7,  25}, {25, 34, 10,  47}, {29, 55, 15,  77}, {33, 80, 20, 114}
+static const QrVersion VERSIONS[QR_MAX_VERSION] = {
+    { 7, 1,  19, 0, {0} },
+    {10, 1,  34, 0, {6, 18} },
+    {15, 1,  55, 0, {6, 22} },
+    {20, 1,  80, 0, {6, 26} },
+    {26, 1, 108, 0, {6, 30} },
+    {18, 2,  68, 0, {6, 34} },
+    {20, 2,  78, 0, {6, 22, 38} },
+    {24, 2,  97, 0, {6, 24, 42} },
+    {30, 2, 116, 0, {6, 26, 46} },
+    {18, 2,  68, 2, {6, 28, 50} },
 };
 
-static uint8_t gf_mul(uint8_t a, uint8_t b) {
-    if (a == 0 || b == 0) return 0;
-    return GF_EXP[(GF_LOG[a] + GF_LOG[b]) % 255];
+static int version_data_cw(const QrVersion *v) {
+    return v->blocks_1 * v->data_1 + v->blocks_2 * (v->data_1 + 1);
+}
+
+typedef enum { QR_MODE_NUMERIC = 0, QR_MODE_ALNUM = 1, QR_MODE_BYTE = 2 } QrMode;
+
+static const uint8_t MODE_INDICATOR[] = {0x1, 0x2, 0x4};
+// Character count bits for versions 1-9 and 10-26
+static const uint8_t COUNT_BITS[][2] = {{10, 12}, {9, 11}, {8, 16}};
+
+static int payload_bits(QrMode mode, int len) {
+    switch (mode) {
+        case QR_MODE_NUMERIC: return (len / 3) * 10 + ((len % 3 == 2) ? 7 : (len % 3 == 1) ? 4 : 0);
+        case QR_MODE_ALNUM:   return (len / 2) * 11 + (len % 2) * 6;
+        default:              return len * 8;
+    }
 }
 
 // Helpers
@@ -53,52 +103,384 @@ static void write_bits(uint8_t *buf, int *bit_pos, int value, int num_bits) {
     }
 }
 
-static void draw_finder(int r0, int c0, int size) {
+// ============================================================================
+// Matrix
+// ============================================================================
+
+static inline bool qr_is_reserved(const QrWork *q, int r, int c) {
+    return q->reserved[r] & QR_BIT(c);
+}
+
+static inline void qr_set(QrWork *q, int r, int c, bool dark) {
+    if (dark) q->modules[r] |= QR_BIT(c);
+    else q->modules[r] &= ~QR_BIT(c);
+}
+
+// Function module: reserved, with a fixed value
+static inline void qr_set_function(QrWork *q, int r, int c, bool dark) {
+    q->reserved[r] |= QR_BIT(c);
+    qr_set(q, r, c, dark);
+}
+
+static void draw_finder(QrWork *q, int r0, int c0, int size) {
     for(int r=-1; r<=7; r++) for(int c=-1; c<=7; c++) {
         if(r0+r < 0 || r0+r >= size || c0+c < 0 || c0+c >= size) continue;
         bool outer = (r==-1||r==7||c==-1||c==7);
         bool border = (r==0||r==6||c==0||c==6);
         bool center = (r>=2&&r<=4&&c>=2&&c<=4);
-        s_qr_matrix[r0+r][c0+c] = (outer ? 0 : (border||center ? 1 : 0));
+        qr_set_function(q, r0+r, c0+c, outer ? 0 : (border||center ? 1 : 0));
+    }
+}
+
+static void draw_alignment(QrWork *q, int r0, int c0) {
+    for(int r=-2; r<=2; r++) for(int c=-2; c<=2; c++) {
+        qr_set_function(q, r0+r, c0+c, r==-2||r==2||c==-2||c==2||(r==0&&c==0));
     }
 }
 
-bool qr_generate_packed(const char *data, uint8_t *output_buffer, uint8_t *out_size) {
-    if (!data || !output_buffer) return false;
+// 18-bit version information: version number and its BCH(18,6) remainder
+static uint32_t version_info_bits(int version) {
+    uint32_t rem = version;
+    for (int i = 0; i < 12; i++) rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
+    return ((uint32_t)version << 12) | rem;
+}
+
+// Function patterns of a version, into both planes
+static void build_function_patterns(QrWork *q, int ver_idx, int size) {
+    const QrVersion *v = &VERSIONS[ver_idx];
+    memset(q->modules, 0, sizeof(q->modules));
+    for (int r = 0; r < QR_MAX_SIZE; r++) q->reserved[r] = (size < 64) ? ~(QrRow)0 >> size : 0;
+
+    draw_finder(q, 0,0, size); 
+    draw_finder(q, 0,size-7, size); 
+    draw_finder(q, size-7,0, size);
     
-    // 1. Validate & Select Version
-    int len = strlen(data);
-    int ver_idx = -1;
-    for(int i=0; i<4; i++) if(len <= VERSIONS[i].alpha_cap) { ver_idx = i; break; }
-    if(ver_idx < 0) return false;
+    // Alignment patterns at every pair of centres, except over the finders
+    int n_align = 0;
+    while (n_align < 3 && v->align[n_align]) n_align++;
+    for (int i = 0; i < n_align; i++) {
+        for (int j = 0; j < n_align; j++) {
+            bool corner = (i == 0 && j == 0) || (i == 0 && j == n_align - 1) || (i == n_align - 1 && j == 0);
+            if (!corner) draw_alignment(q, v->align[i], v->align[j]);
+        }
+    }
+    
+    // Timing
+    for(int i=8; i<size-8; i++) {
+        if(!qr_is_reserved(q, 6, i)) qr_set_function(q, 6, i, i%2==0);
+        if(!qr_is_reserved(q, i, 6)) qr_set_function(q, i, 6, i%2==0);
+    }
+    
+    // Reserve Format Areas (written after masking)
+    for(int i=0; i<9; i++) { if(!qr_is_reserved(q, 8, i)) qr_set_function(q, 8, i, 0); if(!qr_is_reserved(q, i, 8)) qr_set_function(q, i, 8, 0); }
+    for(int i=0; i<8; i++) { if(!qr_is_reserved(q, 8, size-1-i)) qr_set_function(q, 8, size-1-i, 0); if(!qr_is_reserved(q, size-1-i, 8)) qr_set_function(q, size-1-i, 8, 0); }
+    qr_set_function(q, size-8, 8, 1); // Dark Module
+
+    // Version information (v7+): two 6x3 blocks next to the finders
+    if (ver_idx >= 6) {
+        uint32_t bits = version_info_bits(ver_idx + 1);
+        for (int i = 0; i < 18; i++) {
+            bool dark = (bits >> i) & 1;
+            int a = size - 11 + i % 3, b = i / 3;
+            qr_set_function(q, a, b, dark);
+            qr_set_function(q, b, a, dark);
+        }
+    }
+}
+
+// ============================================================================
+// Mask Selection
+// ============================================================================
+// Every mask is applied to a scratch copy of the rows (QrWork.scratch) with
+// its own format bits in place and scored with the four penalty rules. The rules work on
+// whole 64-bit rows: runs, 2x2 blocks and finder-like patterns become
+// ANDs of shifted or neighbouring rows and popcounts, with no per-module
+// loop. The chosen mask is memoized per text (see memo_mask).
+
+#define QR_EC_LEVEL_L 1 // Format information EC level bits (L = 01)
+
+// First 6 columns of rows 0-11 under each mask, column 0 in bit 5:
+//   0: (r + c) % 2 == 0                4: (r / 2 + c / 3) % 2 == 0
+//   1: r % 2 == 0                      5: (r * c) % 2 + (r * c) % 3 == 0
+//   2: c % 3 == 0                      6: ((r * c) % 2 + (r * c) % 3) % 2 == 0
+//   3: (r + c) % 3 == 0                7: ((r + c) % 2 + (r * c) % 3) % 2 == 0
+// Every mask repeats after 12 rows (lcm of 2, 3, 4 and 6) and 6 columns.
+static const uint8_t MASK_UNITS[8][12] = {
+    {0x2A, 0x15, 0x2A, 0x15, 0x2A, 0x15, 0x2A, 0x15, 0x2A, 0x15, 0x2A, 0x15},
+    {0x3F, 0x00, 0x3F, 0x00, 0x3F, 0x00, 0x3F, 0x00, 0x3F, 0x00, 0x3F, 0x00},
+    {0x24, 0x24, 0x24, 0x24, 0x24, 0x24, 0x24, 0x24, 0x24, 0x24, 0x24, 0x24},
+    {0x24, 0x09, 0x12, 0x24, 0x09, 0x12, 0x24, 0x09, 0x12, 0x24, 0x09, 0x12},
+    {0x38, 0x38, 0x07, 0x07, 0x38, 0x38, 0x07, 0x07, 0x38, 0x38, 0x07, 0x07},
+    {0x3F, 0x20, 0x24, 0x2A, 0x24, 0x20, 0x3F, 0x20, 0x24, 0x2A, 0x24, 0x20},
+    {0x3F, 0x38, 0x36, 0x2A, 0x2D, 0x23, 0x3F, 0x38, 0x36, 0x2A, 0x2D, 0x23},
+    {0x2A, 0x07, 0x23, 0x15, 0x38, 0x1C, 0x2A, 0x07, 0x23, 0x15, 0x38, 0x1C},
+};
+
+// Mask `mask` on rows 0-11: row r of the symbol is rows[r % 12], its
+// 6-column unit copied along the word.
+static void build_mask_rows(int mask, QrRow *rows) {
+    for (int r = 0; r < 12; r++) {
+        QrRow unit = (QrRow)MASK_UNITS[mask][r] << 58;
+        QrRow row = unit;
+        for (int c = 6; c < 64; c += 6) row |= unit >> c;
+        rows[r] = row;
+    }
+}
+
+// 15-bit format information: EC level and mask, their BCH(15,5)
+// remainder, XORed with 0x5412
+static uint16_t format_bits(int mask) {
+    uint16_t data = (QR_EC_LEVEL_L << 3) | mask;
+    uint16_t rem = data;
+    for (int i = 0; i < 10; i++) rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+    return ((data << 10) | rem) ^ 0x5412;
+}
+
+// Both copies of the format information, most significant bit first
+static void write_format(QrWork *q, int size, int mask) {
+    uint16_t bits = format_bits(mask);
+    #define FMT(i) ((bits >> (14 - (i))) & 1)
+    for(int i=0; i<6; i++) qr_set(q, 8, i, FMT(i));
+    qr_set(q, 8, 7, FMT(6)); qr_set(q, 8, 8, FMT(7)); qr_set(q, 7, 8, FMT(8));
+    for(int i=9; i<15; i++) qr_set(q, 14-i, 8, FMT(i));
+    for(int i=0; i<7; i++) qr_set(q, size-1-i, 8, FMT(i));
+    for(int i=7; i<15; i++) qr_set(q, 8, size-15+i, FMT(i));
+    #undef FMT
+}
+
+// Top n bits set
+static inline QrRow first_cols(int n) {
+    return (n <= 0) ? 0 : ~(QrRow)0 << (64 - n);
+}
+
+// Popcount without a libgcc call (Cortex-M3 has no popcount instruction)
+static inline int count_bits32(uint32_t x) {
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    x = (x + (x >> 4)) & 0x0F0F0F0Fu;
+    return (x * 0x01010101u) >> 24;
+}
+
+static inline int count_bits(QrRow x) {
+    return x ? count_bits32((uint32_t)(x >> 32)) + count_bits32((uint32_t)x) : 0;
+}
+
+// Rule 1: a run of n >= 5 equal modules costs n - 2. With `same` marking
+// modules equal to their neighbour, a run of n has n - 4 windows of four
+// consecutive same bits and one window start: (n - 4) + 2.
+static inline int penalty_runs(QrRow w4, QrRow w4_prev) {
+    return count_bits(w4) + 2 * count_bits(w4 & ~w4_prev);
+}
+
+// Rule 3: 1011101 (x[0] = first module) with four light modules after it,
+// or before it (the core starting at x[4]), inside the symbol. The core
+// alone rules most rows out before the light modules are looked at.
+#define QR_FINDER_CORE(x) ((x)[0] & ~(x)[1] & (x)[2] & (x)[3] & (x)[4] & ~(x)[5] & (x)[6])
+#define QR_FINDER_LIKE(x, core0, core4) \
+    (((core0) & ~((x)[7] | (x)[8] | (x)[9] | (x)[10])) | \
+     (~((x)[0] | (x)[1] | (x)[2] | (x)[3]) & (core4)))
+
+// Rule 4: 10 per full 5% the dark share is away from 50%
+static int penalty_balance(int dark, int size) {
+    int total = size * size;
+    int diff = dark * 100 - total * 50;
+    if (diff < 0) diff = -diff;
+    return 10 * (diff / (total * 5));
+}
+
+// Score of the symbol under `mask`. Rows are single words, so the rules
+// run along a row with shifts (x << k is the module k to the right) and
+// down all columns at once with neighbouring rows (rows[r + k] is the
+// module k below). Each row is scored as it is masked, the column rules
+// over the windows that end on it, and since every rule only adds,
+// scoring stops as soon as the total reaches `limit` (the best mask so
+// far): most masks are dropped partway down the symbol.
+static int mask_penalty(QrWork *q, int size, int mask, int limit) {
+    write_format(q, size, mask);
+    QrRow pattern[12];
+    build_mask_rows(mask, pattern);
+    QrRow *rows = q->scratch;
+    QrRow all_cols = first_cols(size);
+    QrRow pair_cols = first_cols(size - 1);
+    QrRow finder_cols = first_cols(size - 10);
+    QrRow v_core[8]; // Column finder cores by starting row, mod 8
+    int p = 0, dark = 0;
+
+    QrRow h_prev = 0, v4_prev = 0;
+    for (int r = 0; r < size; r++) {
+        QrRow x = q->modules[r] ^ (pattern[r % 12] & ~q->reserved[r]);
+        rows[r] = x;
+        dark += count_bits(x);
+
+        // Along the row: h marks modules equal to their right neighbour
+        QrRow h = ~(x ^ (x << 1)) & pair_cols;
+        QrRow w4 = h & (h << 1) & (h << 2) & (h << 3);
+        p += penalty_runs(w4, w4 >> 1);
+        QrRow core = x & ~(x << 1) & (x << 2) & (x << 3) & (x << 4) & ~(x << 5) & (x << 6);
+        if ((core | core << 4) & finder_cols) {
+            QrRow shifted[11];
+            for (int k = 0; k < 11; k++) shifted[k] = x << k;
+            p += 40 * count_bits(QR_FINDER_LIKE(shifted, core, core << 4) & finder_cols);
+        }
 
-    // 2. Prepare Data (Uppercase + Check Chars)
-    char upper[115];
-    for(int i=0; i<len; i++) {
-        char c = data[i];
-        if(c >= 'a' && c <= 'z') c -= 32;
-        if(ALPHANUM_MAP[(uint8_t)c] == 255) return false;
-        upper[i] = c;
+        // 2x2 blocks with the row above: equal vertically in both columns
+        // and horizontally in the upper row
+        if (r > 0) {
+            QrRow v = ~(rows[r - 1] ^ x);
+            p += 3 * count_bits(v & (v << 1) & h_prev);
+        }
+        h_prev = h;
+
+        // Down the columns: the run window and finder pattern ending here
+        if (r >= 4) {
+            QrRow v4 = ~(rows[r - 4] ^ rows[r - 3]) & ~(rows[r - 3] ^ rows[r - 2]) &
+                       ~(rows[r - 2] ^ rows[r - 1]) & ~(rows[r - 1] ^ x) & all_cols;
+            p += penalty_runs(v4, v4_prev);
+            v4_prev = v4;
+        }
+        if (r >= 6) v_core[(r - 6) & 7] = QR_FINDER_CORE(rows + r - 6) & all_cols;
+        if (r >= 10) {
+            const QrRow *s = rows + r - 10;
+            QrRow core0 = v_core[(r - 10) & 7], core4 = v_core[(r - 6) & 7];
+            if (core0 | core4) p += 40 * count_bits(QR_FINDER_LIKE(s, core0, core4));
+        }
+        if (p >= limit) return p;
     }
 
+    return p + penalty_balance(dark, size);
+}
+
+// Lowest penalty wins, the lower mask number on ties
+static int select_mask(QrWork *q, int size) {
+#ifdef QR_FIXED_MASK
+    return QR_FIXED_MASK; // Host bench baseline: selection skipped
+#endif
+    int best = 0, best_penalty = INT_MAX;
+    for (int m = 0; m < 8; m++) {
+        int p = mask_penalty(q, size, m, best_penalty);
+        if (p < best_penalty) {
+            best = m;
+            best_penalty = p;
+        }
+    }
+    return best;
+}
+
+// The masks chosen for the last QR_MASK_MEMO texts, by text hash: drawing
+// a card again (flipping back, reopening it, a prefetch after a redraw)
+// reuses its mask and skips selection, so only the first generation of a
+// text pays for it. A hash collision only costs a higher-penalty mask;
+// every mask gives a valid symbol.
+#ifndef QR_MASK_MEMO
+#define QR_MASK_MEMO 4
+#endif
+
+#if QR_MASK_MEMO > 0
+static struct {
+    uint32_t hash; // 0: empty
+    uint8_t mask;
+} s_mask_memo[QR_MASK_MEMO];
+static uint8_t s_mask_memo_next = 0;
+#endif
+
+// FNV-1a of the text, never 0
+static uint32_t text_hash(const char *data, int len) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) h = (h ^ (uint8_t)data[i]) * 16777619u;
+    return h ? h : 1;
+}
+
+static int memo_mask(uint32_t hash) {
+#if QR_MASK_MEMO > 0
+    for (int i = 0; i < QR_MASK_MEMO; i++) {
+        if (s_mask_memo[i].hash == hash) return s_mask_memo[i].mask;
+    }
+#endif
+    return -1;
+}
+
+static void memo_store(uint32_t hash, int mask) {
+#if QR_MASK_MEMO > 0
+    s_mask_memo[s_mask_memo_next].hash = hash;
+    s_mask_memo[s_mask_memo_next].mask = mask;
+    s_mask_memo_next = (s_mask_memo_next + 1) % QR_MASK_MEMO;
+#endif
+}
+
+// ORs the top n bits of `row` into out at bit `pos`, MSB first
+static void pack_row(uint8_t *out, uint32_t pos, QrRow row, int n) {
+    while (n > 0) {
+        int room = 8 - (pos & 7);
+        int take = (n < room) ? n : room;
+        out[pos >> 3] |= (uint8_t)(row >> (64 - take)) << (room - take);
+        row <<= take;
+        pos += take;
+        n -= take;
+    }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool qr_generate_packed(const char *data, int len, uint8_t *output_buffer, uint8_t *out_size) {
+    if (!data || !output_buffer || len < 0) return false;
+    
+    // 1. Select Mode: the narrowest one covering every character
+    QrMode mode = QR_MODE_NUMERIC;
+    for (int i = 0; i < len && mode != QR_MODE_BYTE; i++) {
+        uint8_t c = (uint8_t)data[i];
+        if (c >= '0' && c <= '9') continue;
+        mode = (c < 128 && ALPHANUM_MAP[c] != 255) ? QR_MODE_ALNUM : QR_MODE_BYTE;
+    }
+
+    // 2. Select Version: the smallest whose data codewords hold the segment
+    int ver_idx = -1;
+    int len_bits = 0; // Character count indicator width
+    for (int i = 0; i < QR_MAX_VERSION; i++) {
+        len_bits = COUNT_BITS[mode][i >= 9];
+        if (len < (1 << len_bits) &&
+            4 + len_bits + payload_bits(mode, len) <= version_data_cw(&VERSIONS[i]) * 8) {
+            ver_idx = i;
+            break;
+        }
+    }
+    if (ver_idx < 0) return false;
+    const QrVersion *v = &VERSIONS[ver_idx];
+    int data_len = version_data_cw(v);
+    QrWork *q = malloc(sizeof(QrWork));
+    if (!q) return false;
+    uint8_t *data_cw = q->data_cw;
+
     // 3. Create Data Codewords
-    uint8_t data_cw[80] = {0};
+    memset(data_cw, 0, data_len);
     int bit_pos = 0;
-    write_bits(data_cw, &bit_pos, 0x2, 4); // Mode Alphanumeric
-    write_bits(data_cw, &bit_pos, len, 9); // Char Count
+    write_bits(data_cw, &bit_pos, MODE_INDICATOR[mode], 4);
+    write_bits(data_cw, &bit_pos, len, len_bits);
     
-    for(int i=0; i<len; i+=2) {
-        int val = ALPHANUM_MAP[(uint8_t)upper[i]];
-        if(i+1 < len) {
-            val = val * 45 + ALPHANUM_MAP[(uint8_t)upper[i+1]];
-            write_bits(data_cw, &bit_pos, val, 11);
-        } else {
-            write_bits(data_cw, &bit_pos, val, 6);
+    if (mode == QR_MODE_NUMERIC) {
+        for (int i = 0; i < len; i += 3) {
+            int n = (len - i < 3) ? len - i : 3;
+            int val = 0;
+            for (int k = 0; k < n; k++) val = val * 10 + (data[i + k] - '0');
+            write_bits(data_cw, &bit_pos, val, n * 3 + 1);
         }
+    } else if (mode == QR_MODE_ALNUM) {
+        for(int i=0; i<len; i+=2) {
+            int val = ALPHANUM_MAP[(uint8_t)data[i]];
+            if(i+1 < len) {
+                val = val * 45 + ALPHANUM_MAP[(uint8_t)data[i+1]];
+                write_bits(data_cw, &bit_pos, val, 11);
+            } else {
+                write_bits(data_cw, &bit_pos, val, 6);
+            }
+        }
+    } else {
+        for (int i = 0; i < len; i++) write_bits(data_cw, &bit_pos, (uint8_t)data[i], 8);
     }
     
     // Terminator & Padding
-    int total_bits = VERSIONS[ver_idx].data_cw * 8;
+    int total_bits = data_len * 8;
     int term = total_bits - bit_pos;
     if(term > 4) term = 4;
     write_bits(data_cw, &bit_pos, 0, term);
@@ -107,99 +489,78 @@ bool qr_generate_packed(const char *data, uint8_t *output_buffer, uint8_t *out_s
     // Byte Padding (236, 17)
     int byte_cnt = bit_pos / 8;
     int pad_byte = 236;
-    while(byte_cnt < VERSIONS[ver_idx].data_cw) {
+    while(byte_cnt < data_len) {
         data_cw[byte_cnt++] = pad_byte;
         pad_byte = (pad_byte == 236) ? 17 : 236;
     }
 
-    // 4. Generate EC Codewords
-    uint8_t ec_cw[20] = {0};
-    int ec_len = VERSIONS[ver_idx].ec_cw;
-    for(int i=0; i<VERSIONS[ver_idx].data_cw; i++) {
-        uint8_t factor = data_cw[i] ^ ec_cw[0];
-        memmove(ec_cw, ec_cw + 1, ec_len - 1);
-        ec_cw[ec_len - 1] = 0;
-        for(int j=0; j<ec_len; j++) ec_cw[j] ^= gf_mul(RS_GENERATORS[ver_idx][j+1], factor);
+    // 4. Generate EC Codewords per block, then interleave: the i-th data
+    // codeword of every block in turn (short blocks run out first), then
+    // the i-th EC codeword of every block.
+    int blocks = v->blocks_1 + v->blocks_2;
+    gf_select(QR_GF_POLY);
+    int block_start[4];
+    for (int b = 0, start = 0; b < blocks; b++) {
+        int block_len = v->data_1 + (b >= v->blocks_1);
+        block_start[b] = start;
+        rs_encode(data_cw + start, block_len, q->ec_cw + b * v->ec, v->ec, 0);
+        start += block_len;
     }
-
-    // 5. Construct Matrix (Fill with -1)
-    int size = VERSIONS[ver_idx].size;
-    memset(s_qr_matrix, -1, sizeof(s_qr_matrix));
-
-    // Patterns
-    draw_finder(0,0, size); 
-    draw_finder(0,size-7, size); 
-    draw_finder(size-7,0, size);
-    
-    if(ver_idx >= 1) { // Alignment for V2+
-        int a = size-7;
-        for(int r=-2; r<=2; r++) for(int c=-2; c<=2; c++) {
-            if(s_qr_matrix[a+r][a+c] == -1) s_qr_matrix[a+r][a+c] = (r==-2||r==2||c==-2||c==2||(r==0&&c==0)) ? 1 : 0;
+    int n_cw = 0;
+    for (int i = 0; i <= v->data_1; i++) {
+        for (int b = 0; b < blocks; b++) {
+            if (i < v->data_1 + (b >= v->blocks_1)) q->all_cw[n_cw++] = data_cw[block_start[b] + i];
         }
     }
-    
-    // Timing
-    for(int i=8; i<size-8; i++) {
-        if(s_qr_matrix[6][i] == -1) s_qr_matrix[6][i] = (i%2==0);
-        if(s_qr_matrix[i][6] == -1) s_qr_matrix[i][6] = (i%2==0);
+    for (int i = 0; i < v->ec; i++) {
+        for (int b = 0; b < blocks; b++) q->all_cw[n_cw++] = q->ec_cw[b * v->ec + i];
     }
-    
-    // Reserve Format Areas (set to 0 temp)
-    for(int i=0; i<9; i++) { if(s_qr_matrix[8][i] == -1) s_qr_matrix[8][i]=0; if(s_qr_matrix[i][8] == -1) s_qr_matrix[i][8]=0; }
-    for(int i=0; i<8; i++) { if(s_qr_matrix[8][size-1-i] == -1) s_qr_matrix[8][size-1-i]=0; if(s_qr_matrix[size-1-i][8] == -1) s_qr_matrix[size-1-i][8]=0; }
-    s_qr_matrix[size-8][8] = 1; // Dark Module
-
-    // Place Data
-    uint8_t all_cw[100];
-    memcpy(all_cw, data_cw, VERSIONS[ver_idx].data_cw);
-    memcpy(all_cw + VERSIONS[ver_idx].data_cw, ec_cw, ec_len);
-    
+
+    // 5. Construct Matrix
+    int size = 17 + 4 * (ver_idx + 1);
+    build_function_patterns(q, ver_idx, size);
+
+    // Place Data. Modules past the codewords (remainder bits) stay light.
     int bit_idx = 0;
+    int total_bits_cw = n_cw * 8;
     int col = size-1;
     bool up = true;
     while(col >= 0) {
         if(col == 6) col--;
         for(int r_off=0; r_off<size; r_off++) {
             int r = up ? (size-1-r_off) : r_off;
+            QrRow free_bits = ~q->reserved[r];
             for(int k=0; k<2; k++) {
                 int c = col - k;
-                if(c>=0 && s_qr_matrix[r][c] == -1) {
-                    if(bit_idx < (VERSIONS[ver_idx].data_cw + ec_len)*8) {
-                        s_qr_matrix[r][c] = (all_cw[bit_idx/8] >> (7-(bit_idx%8))) & 1;
-                        bit_idx++;
-                    } else s_qr_matrix[r][c] = 0;
+                if(c>=0 && (free_bits & QR_BIT(c)) && bit_idx < total_bits_cw) {
+                    if ((q->all_cw[bit_idx/8] >> (7-(bit_idx%8))) & 1) q->modules[r] |= QR_BIT(c);
+                    bit_idx++;
                 }
             }
         }
         col -= 2; up = !up;
     }
 
-    // Mask (0: (r+c)%2==0) & Format Info
-    const uint8_t FMT[] = {1,1,1,0,1,1,1,1,1,0,0,0,1,0,0};
-    for(int r=0; r<size; r++) for(int c=0; c<size; c++) {
-        // Is reserved? Re-check logic simply by exclusion
-        bool reserved = (r<9&&c<9) || (r<9&&c>=size-8) || (r>=size-8&&c<9) || (r==6||c==6);
-        if(ver_idx>=1) { int a=size-7; if(r>=a-2&&r<=a+2&&c>=a-2&&c<=a+2) reserved=true; }
-        if(!reserved && (r+c)%2==0) s_qr_matrix[r][c] ^= 1;
+    // Mask & Format Info
+    uint32_t hash = text_hash(data, len);
+    int mask = memo_mask(hash);
+    if (mask < 0) {
+        mask = select_mask(q, size);
+        memo_store(hash, mask);
     }
-    
-    // Write Format Bits
-    for(int i=0; i<6; i++) s_qr_matrix[8][i] = FMT[i];
-    s_qr_matrix[8][7] = FMT[6]; s_qr_matrix[8][8] = FMT[7]; s_qr_matrix[7][8] = FMT[8];
-    for(int i=9; i<15; i++) s_qr_matrix[14-i][8] = FMT[i];
-    for(int i=0; i<7; i++) s_qr_matrix[size-1-i][8] = FMT[i];
-    for(int i=7; i<15; i++) s_qr_matrix[8][size-15+i] = FMT[i];
+    QrRow pattern[12];
+    build_mask_rows(mask, pattern);
+    for(int r=0; r<size; r++) q->modules[r] ^= pattern[r % 12] & ~q->reserved[r];
+    write_format(q, size, mask);
 
     // 6. Pack Output
     *out_size = size;
     int total_bytes = (size * size + 7) / 8;
     memset(output_buffer, 0, total_bytes);
-    for(int r=0; r<size; r++) for(int c=0; c<size; c++) {
-        if(s_qr_matrix[r][c]) {
-            int idx = r*size + c;
-            output_buffer[idx/8] |= (1 << (7-(idx%8)));
-        }
-    }
+    for(int r=0; r<size; r++) pack_row(output_buffer, r * size, q->modules[r], size);
+    free(q);
     
     return true;
-}
\ No newline at end of file
+}
+
+#endif
@@ -1,74 +1,895 @@
 #include "common.h"
-#include <stddef.h> 
+#include <stddef.h>
 
 // Keys:
 // PERSIST_KEY_COUNT: card count
 // PERSIST_KEY_BASE-1: Global Invert Setting
+// PERSIST_KEY_BASE-2..-3: Menu order and quick launch settings
+// PERSIST_KEY_BASE-4: Slot of the card opened last
+// RECORD_KEY_BASE-1: Storage format version
+// RECORD_KEY_BASE + (s*9) + 0: Info record
+// RECORD_KEY_BASE + (s*9) + 1..4: Data record
+// RECORD_KEY_BASE + (s*9) + 5..8: Display list record (optional)
+// (s = the card's storage slot, CardIndexEntry.slot)
+// RECORD_KEY_BASE + (MAX_CARDS*9) + 0: Card refs record
+// RECORD_KEY_BASE + (MAX_CARDS*9) + 1 + p: Menu row page p
+// RECORD_KEY_BASE + (MAX_CARDS*9) + 5: Card usage record
+//
+// STORAGE_VERSION 1 (10 cards, migrated on first load) had a single index
+// record at RECORD_KEY_BASE + 90, now slot 10.
+//
+// Legacy layout (STORAGE_VERSION 0, migrated on first load):
 // BASE + (i*12): Info
-// BASE + (i*12) + 1..11: Data
+// BASE + (i*12) + 1..11: Data in 100 byte chunks
+//
+// Quota: the watch gives an app 4 KB of persist storage, keys and their
+// bookkeeping included (the bench fake charges 12 bytes a key). MAX_CARDS
+// is sized to it:
+// - Fixed: refs (always MAX_CARDS entries) and usage records, settings,
+//   count and version: 360 bytes.
+// - Per card: info record 64, data record 20 plus the payload, a fifth of
+//   a menu page 46: 130 bytes plus the payload.
+// 20 cards fit with payloads up to 56 bytes on average, 10 of 256 bytes, 3
+// of 968 (`make -C bench run` measures it). Display lists and menu pages can be rebuilt, so they give
+// way when a card doesn't fit; a card that still doesn't fit is reported to
+// the caller (storage_save_card).
 
-#define KEYS_PER_CARD 12
-#define STORAGE_CHUNK_SIZE 100 
 #define KEY_SETTING_INVERT (PERSIST_KEY_BASE - 1)
+#define KEY_SETTING_SORT (PERSIST_KEY_BASE - 2)
+#define KEY_SETTING_QUICK_LAUNCH (PERSIST_KEY_BASE - 3)
+#define KEY_LAST_OPENED (PERSIST_KEY_BASE - 4)
+
+// ============================================================================
+// Records
+// ============================================================================
+// A record is a header followed by its payload, split across consecutive
+// keys of PERSIST_DATA_MAX_LENGTH bytes. The first key holds the header and
+// the start of the payload, so a load is one read per key and needs no
+// persist_exists probing. The CRC covers the payload and catches torn or
+// stale writes.
+
+#define STORAGE_VERSION 2 // Key layout
+#define RECORD_VERSION 1  // Record header; unchanged since STORAGE_VERSION 1
+#define KEY_STORAGE_VERSION (RECORD_KEY_BASE - 1)
+#define RECORD_KEY_BASE (PERSIST_KEY_BASE + 1000)
+
+typedef enum {
+    RECORD_INFO = 1,      // STORAGE_VERSION 1 WalletCardInfo, read by the migrations only
+    RECORD_DATA = 2,
+    RECORD_DLIST = 3,
+    RECORD_INDEX = 4,     // STORAGE_VERSION 1 index, read by the migration only
+    RECORD_REFS = 5,
+    RECORD_INDEX_PAGE = 6,
+    RECORD_USAGE = 7,
+    RECORD_CARD_INFO = 8  // InfoRecord
+} RecordKind;
+
+typedef struct {
+    uint8_t version;
+    uint8_t kind;
+    uint16_t length;
+    uint32_t crc;
+} RecordHeader;
+
+// What a card's info record keeps of its WalletCardInfo: its menu row (the
+// name as the menu shows it and the subtitle instead of the description,
+// which nothing else shows) and what the renderer needs.
+typedef struct {
+    CardIndexEntry row;
+    uint8_t encoding; // CardEncoding
+} InfoRecord;
+
+#define RECORD_HEADER_SIZE ((int)sizeof(RecordHeader))
+#define RECORD_KEYS(len) ((RECORD_HEADER_SIZE + (len) + PERSIST_DATA_MAX_LENGTH - 1) / PERSIST_DATA_MAX_LENGTH)
+
+#define INFO_KEYS RECORD_KEYS(sizeof(WalletCardInfo)) // Also holds a STORAGE_VERSION 1 record
+#define DATA_KEYS RECORD_KEYS(MAX_BITS_LEN)
+#define DLIST_KEYS RECORD_KEYS(DLIST_MAX_LEN)
+#define RECORD_KEYS_PER_CARD (INFO_KEYS + DATA_KEYS + DLIST_KEYS)
+
+#define CARD_KEY(i) (RECORD_KEY_BASE + (i) * RECORD_KEYS_PER_CARD)
+#define INFO_KEY(i) CARD_KEY(i)
+#define DATA_KEY(i) (CARD_KEY(i) + INFO_KEYS)
+#define DLIST_KEY(i) (DATA_KEY(i) + DATA_KEYS)
+
+#define REFS_KEY CARD_KEY(MAX_CARDS)
+#define REFS_KEYS RECORD_KEYS(sizeof(CardRef) * MAX_CARDS)
+#define INDEX_PAGE_ROWS ((PERSIST_DATA_MAX_LENGTH - RECORD_HEADER_SIZE) / (int)sizeof(CardIndexEntry))
+#define INDEX_PAGES ((MAX_CARDS + INDEX_PAGE_ROWS - 1) / INDEX_PAGE_ROWS)
+#define PAGE_KEY(p) (REFS_KEY + REFS_KEYS + (p))
+#define USAGE_KEY PAGE_KEY(INDEX_PAGES)
+#define USAGE_KEYS RECORD_KEYS(sizeof(CardUsage) * MAX_CARDS)
+#define REF_SLOT_NONE 0xFF // Refs record entries past the card count
+
+// CRC-32 (IEEE, reflected), nibble table
+static uint32_t crc32(const uint8_t *data, int len) {
+    static const uint32_t TABLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+        crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+// Number of keys the record at base_key currently occupies (0 if none)
+static int record_keys_in_use(uint32_t base_key) {
+    RecordHeader header;
+    if (persist_read_data(base_key, &header, sizeof(header)) != (int)sizeof(header)) return 0;
+    if (header.version != RECORD_VERSION) return 1;
+    return RECORD_KEYS(header.length);
+}
+
+static void record_delete(uint32_t base_key, int from_key, int max_keys) {
+    int in_use = record_keys_in_use(base_key);
+    if (in_use > max_keys) in_use = max_keys;
+    for (int k = from_key; k < in_use; k++) persist_delete(base_key + k);
+}
+
+static bool record_write(uint32_t base_key, int max_keys, RecordKind kind, const void *data, int len) {
+    if (len < 0 || RECORD_KEYS(len) > max_keys) return false;
+    const uint8_t *src = data;
+
+    // Drop keys the new record no longer needs
+    record_delete(base_key, RECORD_KEYS(len), max_keys);
+
+    uint8_t chunk[PERSIST_DATA_MAX_LENGTH];
+    RecordHeader header = { .version = RECORD_VERSION, .kind = kind, .length = len, .crc = crc32(src, len) };
+    memcpy(chunk, &header, sizeof(header));
+
+    int offset = 0;
+    int fill = RECORD_HEADER_SIZE;
+    for (int k = 0; k < RECORD_KEYS(len); k++) {
+        int n = len - offset;
+        if (n > PERSIST_DATA_MAX_LENGTH - fill) n = PERSIST_DATA_MAX_LENGTH - fill;
+        memcpy(chunk + fill, src + offset, n);
+        if (persist_write_data(base_key + k, chunk, fill + n) != fill + n) return false;
+        offset += n;
+        fill = 0;
+    }
+    return true;
+}
+
+// Payload length, 0 if there is no record, -1 if it's damaged or too large.
+static int record_read(uint32_t base_key, int max_keys, RecordKind kind, void *buffer, int max_len) {
+    uint8_t chunk[PERSIST_DATA_MAX_LENGTH];
+    int read = persist_read_data(base_key, chunk, sizeof(chunk));
+    if (read < RECORD_HEADER_SIZE) return (read == E_DOES_NOT_EXIST) ? 0 : -1;
+
+    RecordHeader header;
+    memcpy(&header, chunk, sizeof(header));
+    if (header.version != RECORD_VERSION || header.kind != kind ||
+        header.length > max_len || RECORD_KEYS(header.length) > max_keys) return -1;
+
+    uint8_t *dst = buffer;
+    int offset = read - RECORD_HEADER_SIZE;
+    if (offset > header.length) offset = header.length;
+    memcpy(dst, chunk + RECORD_HEADER_SIZE, offset);
+
+    for (int k = 1; offset < header.length; k++) {
+        int want = header.length - offset;
+        if (want > PERSIST_DATA_MAX_LENGTH) want = PERSIST_DATA_MAX_LENGTH;
+        if (persist_read_data(base_key + k, dst + offset, want) != want) return -1;
+        offset += want;
+    }
+
+    if (crc32(dst, header.length) != header.crc) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "Record %d failed CRC", (int)base_key);
+        return -1;
+    }
+    return header.length;
+}
+
+// Copies at most dst_len - 1 chars of src (which may lack a terminator within src_len)
+static void copy_truncated(char *dst, int dst_len, const char *src, int src_len) {
+    int n = 0;
+    while (n < dst_len - 1 && n < src_len && src[n] != '\0') n++;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+static void row_from_info(CardIndexEntry *e, const WalletCardInfo *info) {
+    static const char *FORMAT_NAMES[] = {"Code 128", "Code 39", "EAN-13", "QR Code", "Aztec", "PDF417", "UPC-A", "EAN-8"};
+    memset(e, 0, sizeof(*e));
+    e->width = info->width;
+    e->height = info->height;
+    e->format = info->format;
+    copy_truncated(e->name, INDEX_NAME_LEN, info->name, MAX_NAME_LEN);
+    if (info->description[0] != '\0') {
+        copy_truncated(e->subtitle, INDEX_SUBTITLE_LEN, info->description, MAX_NAME_LEN);
+    } else {
+        int fi = (int)info->format;
+        copy_truncated(e->subtitle, INDEX_SUBTITLE_LEN, (fi >= 0 && fi <= FORMAT_EAN8) ? FORMAT_NAMES[fi] : "Barcode", 16);
+    }
+}
+
+// Older WalletCardInfo records end before the encoding field: those cards
+// are packed, or text when they have no size
+static bool info_write(int slot, const WalletCardInfo *info) {
+    InfoRecord r;
+    memset(&r, 0, sizeof(r));
+    row_from_info(&r.row, info);
+    r.encoding = info->encoding;
+    if (r.encoding == ENCODING_PACKED && (info->width == 0 || info->height == 0)) r.encoding = ENCODING_TEXT;
+    return record_write(INFO_KEY(slot), INFO_KEYS, RECORD_CARD_INFO, &r, sizeof(r));
+}
+
+// ============================================================================
+// Migration from the 12-keys-per-card layout
+// ============================================================================
+
+#define LEGACY_MAX_CARDS 10
+#define LEGACY_KEYS_PER_CARD 12
+#define LEGACY_CHUNK_SIZE 100
+#define LEGACY_DLIST_KEYS 4
+#define LEGACY_DLIST_KEY_BASE (PERSIST_KEY_BASE + LEGACY_MAX_CARDS * LEGACY_KEYS_PER_CARD)
+
+// Cards left in the old layout when the quota ran out mid-migration: their
+// keys stay until a later launch migrates them or a sync replaces the wallet
+static bool s_legacy_pending = false;
+static int s_legacy_migrated = MAX_CARDS; // Cards index_rebuild may list
+
+static void legacy_delete_card(int i) {
+    int base_key = PERSIST_KEY_BASE + (i * LEGACY_KEYS_PER_CARD);
+    for (int k = 0; k < LEGACY_KEYS_PER_CARD; k++) {
+        if (persist_exists(base_key + k)) persist_delete(base_key + k);
+    }
+}
+
+// Puts back a card whose new records didn't fit, as it was read
+static void legacy_restore_card(int i, const WalletCardInfo *info, int info_len, const uint8_t *bits, int len) {
+    int base_key = PERSIST_KEY_BASE + (i * LEGACY_KEYS_PER_CARD);
+    bool ok = persist_write_data(base_key, info, info_len) == info_len;
+    for (int k = 1; ok && (k - 1) * LEGACY_CHUNK_SIZE < len; k++) {
+        int n = len - (k - 1) * LEGACY_CHUNK_SIZE;
+        if (n > LEGACY_CHUNK_SIZE) n = LEGACY_CHUNK_SIZE;
+        ok = persist_write_data(base_key + k, bits + (k - 1) * LEGACY_CHUNK_SIZE, n) == n;
+    }
+    if (!ok) APP_LOG(APP_LOG_LEVEL_ERROR, "Legacy card %d not restored", i);
+}
+
+// Card by card: the card's old keys are deleted first to make room for its
+// new records, and put back if those don't fit, so a full quota stops the
+// migration without losing a card. Cards migrated by an earlier, stopped
+// run have no old keys left and are skipped.
+static void storage_migrate_legacy(void) {
+    int count = persist_exists(PERSIST_KEY_COUNT) ? persist_read_int(PERSIST_KEY_COUNT) : 0;
+    if (count > LEGACY_MAX_CARDS) count = LEGACY_MAX_CARDS;
+    uint8_t *bits = malloc(MAX_BITS_LEN);
+    if (!bits) return; // Try again on the next launch
+
+    // Display lists are rebuilt on the next sync: their quota goes first
+    for (int key = LEGACY_DLIST_KEY_BASE; key < LEGACY_DLIST_KEY_BASE + LEGACY_MAX_CARDS * LEGACY_DLIST_KEYS; key++) {
+        if (persist_exists(key)) persist_delete(key);
+    }
+
+    int migrated = 0;
+    for (; migrated < count; migrated++) {
+        int i = migrated;
+        int base_key = PERSIST_KEY_BASE + (i * LEGACY_KEYS_PER_CARD);
+        WalletCardInfo info;
+        memset(&info, 0, sizeof(info));
+        int info_len = persist_read_data(base_key, &info, sizeof(info));
+        if (info_len <= 0) continue;
+
+        int total_read = 0;
+        for (int k = 1; k < LEGACY_KEYS_PER_CARD && total_read < MAX_BITS_LEN; k++) {
+            if (!persist_exists(base_key + k)) break;
+            int want = MAX_BITS_LEN - total_read;
+            if (want > LEGACY_CHUNK_SIZE) want = LEGACY_CHUNK_SIZE;
+            int read = persist_read_data(base_key + k, bits + total_read, want);
+            if (read <= 0) break;
+            total_read += read;
+        }
+
+        legacy_delete_card(i);
+        if (!info_write(i, &info) || !record_write(DATA_KEY(i), DATA_KEYS, RECORD_DATA, bits, total_read)) {
+            record_delete(INFO_KEY(i), 0, INFO_KEYS);
+            record_delete(DATA_KEY(i), 0, DATA_KEYS);
+            legacy_restore_card(i, &info, info_len, bits, total_read);
+            APP_LOG(APP_LOG_LEVEL_WARNING, "Storage full: %d of %d cards migrated", i, count);
+            break;
+        }
+    }
+    free(bits);
+
+    // The refs are rebuilt from the migrated cards (index_rebuild)
+    record_delete(REFS_KEY, 0, REFS_KEYS);
+    if (migrated < count) {
+        s_legacy_pending = true;
+        s_legacy_migrated = migrated;
+        return;
+    }
+    for (int i = count; i < LEGACY_MAX_CARDS; i++) legacy_delete_card(i); // Left by a bigger wallet
+    persist_write_int(KEY_STORAGE_VERSION, STORAGE_VERSION);
+}
+
+// A sync replaces the wallet, unmigrated cards included
+static void legacy_discard(void) {
+    if (!s_legacy_pending) return;
+    for (int i = 0; i < LEGACY_MAX_CARDS; i++) legacy_delete_card(i);
+    s_legacy_pending = false;
+    s_legacy_migrated = MAX_CARDS;
+    persist_write_int(KEY_STORAGE_VERSION, STORAGE_VERSION);
+}
+
+// ============================================================================
+// Card Usage
+// ============================================================================
+// Opens and the day of the last open per storage slot, for the frecency menu
+// order: a reordered card keeps its history, a removed one loses it. Loaded
+// on first use and written with the index. The slot opened last is written
+// as soon as it changes, for quick launch.
+
+static CardUsage s_usage[MAX_CARDS];
+static bool s_usage_loaded = false;
+static bool s_usage_dirty = false;
+static int s_last_slot = -1;
+
+static void usage_load(void) {
+    if (s_usage_loaded) return;
+    s_usage_loaded = true;
+    // Missing or damaged: no history
+    if (record_read(USAGE_KEY, USAGE_KEYS, RECORD_USAGE, s_usage, sizeof(s_usage)) <= 0) {
+        memset(s_usage, 0, sizeof(s_usage));
+    }
+}
+
+static void usage_forget(int slot) {
+    usage_load();
+    if (s_usage[slot].opens || s_usage[slot].day) {
+        memset(&s_usage[slot], 0, sizeof(CardUsage));
+        s_usage_dirty = true;
+    }
+    if (slot == s_last_slot) {
+        s_last_slot = -1;
+        persist_delete(KEY_LAST_OPENED);
+    }
+}
+
+// A cleared wallet keeps no history, not even for slots no card refers to,
+// and quick launch has no card to open
+static void usage_clear(void) {
+    usage_load();
+    memset(s_usage, 0, sizeof(s_usage));
+    s_usage_dirty = true;
+    s_last_slot = -1;
+    persist_delete(KEY_LAST_OPENED);
+}
+
+static void usage_flush(void) {
+    if (!s_usage_dirty) return;
+    if (!record_write(USAGE_KEY, USAGE_KEYS, RECORD_USAGE, s_usage, sizeof(s_usage))) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "Card usage not stored");
+    }
+    s_usage_dirty = false;
+}
+
+// ============================================================================
+// Card Index
+// ============================================================================
+// What the menu needs, in two parts:
+// - g_card_refs: hash and storage slot of every card, one record read at
+//   launch and kept in RAM.
+// - Menu rows (name, precomputed subtitle, format, size), INDEX_PAGE_ROWS
+//   to a one-key page. Only INDEX_WINDOW_PAGES pages are held in RAM;
+//   storage_index_entry() pages them in around the row asked for, evicting
+//   the page farthest from it, so scrolling reads one key every
+//   INDEX_PAGE_ROWS rows.
+// Card saves update RAM; storage_flush_index() writes the refs and dirty
+// pages once a sync settles (and a page when it is evicted). The info
+// records stay authoritative: missing or damaged refs or pages are rebuilt
+// from them.
+//
+// Cards live in storage slots; the refs map menu position to slot, so
+// reordering or removing cards moves no card data.
+
+#if defined(PBL_PLATFORM_APLITE)
+#define INDEX_WINDOW_PAGES 2 // 10 rows around the selection: 24 KB of app RAM
+#else
+#define INDEX_WINDOW_PAGES 4
+#endif
+
+typedef struct {
+    int16_t page; // -1: empty
+    bool dirty;
+    CardIndexEntry rows[INDEX_PAGE_ROWS];
+} IndexPage;
+
+static IndexPage s_window[INDEX_WINDOW_PAGES];
+static bool s_refs_dirty = false;
+
+static bool load_info_slot(int slot, InfoRecord *r) {
+    memset(r, 0, sizeof(*r));
+    return record_read(INFO_KEY(slot), INFO_KEYS, RECORD_CARD_INFO, r, sizeof(*r)) == (int)sizeof(*r);
+}
+
+static void delete_slot(int slot) {
+    usage_forget(slot);
+    record_delete(INFO_KEY(slot), 0, INFO_KEYS);
+    record_delete(DATA_KEY(slot), 0, DATA_KEYS);
+    record_delete(DLIST_KEY(slot), 0, DLIST_KEYS);
+}
+
+// First slot not used by cards [0, count) of the index
+static int free_slot(int count) {
+    bool used[MAX_CARDS] = { false };
+    for (int i = 0; i < count; i++) used[g_card_refs[i].slot] = true;
+    for (int slot = 0; slot < MAX_CARDS; slot++) {
+        if (!used[slot]) return slot;
+    }
+    return -1;
+}
+
+static void page_write(IndexPage *pg) {
+    if (!record_write(PAGE_KEY(pg->page), 1, RECORD_INDEX_PAGE, pg->rows, sizeof(pg->rows))) {
+        // A stale page must not come back: rebuilt from the info records instead
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Index page %d not stored", pg->page);
+        record_delete(PAGE_KEY(pg->page), 0, 1);
+    }
+    pg->dirty = false;
+}
+
+static void page_rebuild(IndexPage *pg) {
+    for (int r = 0; r < INDEX_PAGE_ROWS; r++) {
+        int index = pg->page * INDEX_PAGE_ROWS + r;
+        CardIndexEntry *e = &pg->rows[r];
+        InfoRecord info;
+        if (index >= g_card_count) {
+            memset(e, 0, sizeof(*e));
+        } else if (load_info_slot(g_card_refs[index].slot, &info)) {
+            *e = info.row;
+        } else {
+            // Keep the row so later cards keep their index; it shows up as needing a resync
+            memset(e, 0, sizeof(*e));
+            strncpy(e->name, "Damaged card", INDEX_NAME_LEN - 1);
+        }
+    }
+    pg->dirty = true;
+}
+
+static IndexPage *index_page(int page) {
+    IndexPage *pg = NULL;
+    for (int i = 0; i < INDEX_WINDOW_PAGES; i++) {
+        IndexPage *w = &s_window[i];
+        if (w->page == page) return w;
+        if (w->page < 0) {
+            if (!pg || pg->page >= 0) pg = w;
+        } else if (!pg || (pg->page >= 0 && abs(w->page - page) > abs(pg->page - page))) {
+            pg = w;
+        }
+    }
+    if (pg->page >= 0 && pg->dirty) page_write(pg);
+
+    pg->page = page;
+    pg->dirty = false;
+    if (record_read(PAGE_KEY(page), 1, RECORD_INDEX_PAGE, pg->rows, sizeof(pg->rows)) != (int)sizeof(pg->rows)) {
+        page_rebuild(pg);
+    }
+    return pg;
+}
+
+static void window_reset(void) {
+    for (int i = 0; i < INDEX_WINDOW_PAGES; i++) {
+        s_window[i].page = -1;
+        s_window[i].dirty = false;
+    }
+}
+
+static void index_set_row(int index, const CardIndexEntry *row) {
+    IndexPage *pg = index_page(index / INDEX_PAGE_ROWS);
+    pg->rows[index % INDEX_PAGE_ROWS] = *row;
+    pg->dirty = true;
+}
+
+static void index_set_entry(int index, int slot, uint32_t hash, const WalletCardInfo *info) {
+    g_card_refs[index].hash = hash;
+    g_card_refs[index].slot = slot;
+    s_refs_dirty = true;
+    CardIndexEntry row;
+    row_from_info(&row, info);
+    index_set_row(index, &row);
+}
+
+// Refs from the info records in slot order; pages are rebuilt as they are read
+static void index_rebuild(void) {
+    g_card_count = persist_exists(PERSIST_KEY_COUNT) ? persist_read_int(PERSIST_KEY_COUNT) : 0;
+    if (g_card_count > s_legacy_migrated) g_card_count = s_legacy_migrated;
+    if (g_card_count < 0) g_card_count = 0;
+
+    // Hashes are unknown, so the next delta sync re-sends these cards
+    for (int i = 0; i < g_card_count; i++) {
+        g_card_refs[i].hash = CARD_HASH_NONE;
+        g_card_refs[i].slot = i;
+    }
+    window_reset();
+    for (int p = 0; p < INDEX_PAGES; p++) record_delete(PAGE_KEY(p), 0, 1);
+    s_refs_dirty = true; // Also with no cards: a fresh install reserves the record
+    storage_flush_index();
+}
+
+void storage_flush_index(void) {
+    for (int i = 0; i < INDEX_WINDOW_PAGES; i++) {
+        if (s_window[i].page >= 0 && s_window[i].dirty) page_write(&s_window[i]);
+    }
+    usage_flush();
+    if (!s_refs_dirty) return;
+    // Always MAX_CARDS entries, so the record never needs more of the quota
+    for (int i = g_card_count; i < MAX_CARDS; i++) {
+        g_card_refs[i].hash = CARD_HASH_NONE;
+        g_card_refs[i].slot = REF_SLOT_NONE;
+    }
+    if (!record_write(REFS_KEY, REFS_KEYS, RECORD_REFS, g_card_refs, sizeof(CardRef) * MAX_CARDS)) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Card index not stored");
+        return;
+    }
+    // Backup for index_rebuild()
+    persist_write_int(PERSIST_KEY_COUNT, g_card_count);
+    s_refs_dirty = false;
+}
+
+const CardIndexEntry *storage_index_entry(int index) {
+    if (index < 0 || index >= g_card_count) return NULL;
+    return &index_page(index / INDEX_PAGE_ROWS)->rows[index % INDEX_PAGE_ROWS];
+}
+
+// Scratch for storage_apply_manifest, too big for the aplite stack
+typedef struct {
+    CardRef old[MAX_CARDS];
+    int8_t from[MAX_CARDS]; // Old index of each new card, -1 for a placeholder
+    bool matched[MAX_CARDS];
+    bool used[MAX_CARDS];   // Slots
+} ManifestScratch;
+
+// Replaces the card list with `count` cards identified by content hash.
+// Cards whose hash is already stored keep their slot (a reorder or removal
+// moves no card data, only menu rows); the others get a free slot and a
+// placeholder row, and their bit is set in `needed` so the phone sends them.
+// Records of cards that are gone are deleted to give the quota back.
+int storage_apply_manifest(const uint32_t *hashes, int count, uint8_t *needed) {
+    if (count > MAX_CARDS) count = MAX_CARDS;
+    if (count < 0) count = 0;
+    ManifestScratch *m = malloc(sizeof(ManifestScratch));
+    if (!m) return -1;
+    legacy_discard();
+    int old_count = g_card_count;
+    memcpy(m->old, g_card_refs, sizeof(CardRef) * old_count);
+    memset(m->matched, 0, sizeof(m->matched));
+    memset(m->used, 0, sizeof(m->used));
+    memset(needed, 0, (count + 7) / 8);
+
+    bool moved = false;
+    for (int i = 0; i < count; i++) {
+        m->from[i] = -1;
+        for (int j = 0; j < old_count; j++) {
+            if (!m->matched[j] && hashes[i] != CARD_HASH_NONE && m->old[j].hash == hashes[i]) {
+                m->from[i] = j;
+                m->matched[j] = true;
+                if (j != i) moved = true;
+                break;
+            }
+        }
+    }
+
+    // Kept cards that moved take their menu row along
+    CardIndexEntry *rows = NULL;
+    if (moved) {
+        rows = malloc(sizeof(CardIndexEntry) * old_count);
+        if (!rows) {
+            free(m);
+            return -1;
+        }
+        for (int j = 0; j < old_count; j++) {
+            if (m->matched[j]) rows[j] = *storage_index_entry(j);
+        }
+    }
+
+    // Placeholders go into slots no kept card uses
+    for (int i = 0; i < count; i++) {
+        if (m->from[i] < 0) continue;
+        g_card_refs[i] = m->old[m->from[i]];
+        m->used[g_card_refs[i].slot] = true;
+    }
+    int pending = 0;
+    for (int i = 0; i < count; i++) {
+        if (m->from[i] >= 0) continue;
+        int slot = 0;
+        while (m->used[slot]) slot++;
+        m->used[slot] = true;
+        g_card_refs[i].hash = CARD_HASH_NONE;
+        g_card_refs[i].slot = slot;
+        needed[i / 8] |= 1 << (i % 8);
+        pending++;
+    }
+    g_card_count = count;
+    s_refs_dirty = true;
+
+    CardIndexEntry placeholder;
+    memset(&placeholder, 0, sizeof(placeholder));
+    strncpy(placeholder.name, "Syncing...", INDEX_NAME_LEN - 1);
+    for (int i = 0; i < count; i++) {
+        if (m->from[i] < 0) index_set_row(i, &placeholder);
+        else if (m->from[i] != i) index_set_row(i, &rows[m->from[i]]);
+    }
+
+    // Also when a placeholder reuses the slot: an interrupted sync must not
+    // show the old card's barcode under the new entry.
+    for (int j = 0; j < old_count; j++) {
+        if (!m->matched[j]) delete_slot(m->old[j].slot);
+    }
+    free(rows);
+    free(m);
+
+    storage_flush_index();
+    return pending;
+}
+
+// ============================================================================
+// Migration from the single index record
+// ============================================================================
+// STORAGE_VERSION 1 held at most 10 cards and kept their whole index in one
+// record right after their slots, where slot 10 is now.
+
+#define V1_MAX_CARDS 10
+#define V1_INDEX_KEY CARD_KEY(V1_MAX_CARDS)
+
+typedef struct {
+    uint32_t hash;
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;
+    uint8_t slot;
+    char name[INDEX_NAME_LEN];
+    char subtitle[INDEX_SUBTITLE_LEN];
+} V1IndexEntry;
+
+#define V1_INDEX_KEYS RECORD_KEYS(sizeof(V1IndexEntry) * V1_MAX_CARDS)
+
+static void storage_migrate_v1(void) {
+    V1IndexEntry *old = malloc(sizeof(V1IndexEntry) * V1_MAX_CARDS);
+    if (!old) return; // Try again on the next launch
+    int len = record_read(V1_INDEX_KEY, V1_INDEX_KEYS, RECORD_INDEX, old, sizeof(V1IndexEntry) * V1_MAX_CARDS);
+    for (int k = 0; k < (int)V1_INDEX_KEYS; k++) persist_delete(V1_INDEX_KEY + k);
+
+    // Info records shrink to InfoRecords. One already converted by a
+    // migration that was cut short no longer reads as RECORD_INFO.
+    for (int slot = 0; slot < V1_MAX_CARDS; slot++) {
+        WalletCardInfo info;
+        memset(&info, 0, sizeof(info));
+        if (record_read(INFO_KEY(slot), INFO_KEYS, RECORD_INFO, &info, sizeof(info)) >=
+            (int)offsetof(WalletCardInfo, encoding)) {
+            info_write(slot, &info);
+        }
+    }
+
+    bool valid = (len > 0 && len % sizeof(V1IndexEntry) == 0);
+    for (int i = 0; valid && i < len / (int)sizeof(V1IndexEntry); i++) valid = old[i].slot < V1_MAX_CARDS;
+    window_reset();
+    if (valid) {
+        g_card_count = len / sizeof(V1IndexEntry);
+        for (int i = 0; i < g_card_count; i++) {
+            g_card_refs[i].hash = old[i].hash;
+            g_card_refs[i].slot = old[i].slot;
+        }
+        for (int i = 0; i < g_card_count; i++) {
+            CardIndexEntry row;
+            memset(&row, 0, sizeof(row));
+            row.width = old[i].width;
+            row.height = old[i].height;
+            row.format = old[i].format;
+            memcpy(row.name, old[i].name, INDEX_NAME_LEN);
+            memcpy(row.subtitle, old[i].subtitle, INDEX_SUBTITLE_LEN);
+            index_set_row(i, &row);
+        }
+        s_refs_dirty = true;
+        storage_flush_index();
+    } else {
+        index_rebuild();
+    }
+    free(old);
+    persist_write_int(KEY_STORAGE_VERSION, STORAGE_VERSION);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
 
 void storage_load_settings(void) {
     // 1. Load Invert Setting
     g_invert_colors = persist_exists(KEY_SETTING_INVERT) ? persist_read_bool(KEY_SETTING_INVERT) : false;
+    g_sort_by_use = persist_exists(KEY_SETTING_SORT) ? persist_read_bool(KEY_SETTING_SORT) : false;
+    g_quick_launch = persist_exists(KEY_SETTING_QUICK_LAUNCH) ? persist_read_int(KEY_SETTING_QUICK_LAUNCH) : QUICK_LAUNCH_OFF;
+    s_last_slot = persist_exists(KEY_LAST_OPENED) ? persist_read_int(KEY_LAST_OPENED) : -1;
+    s_usage_loaded = s_usage_dirty = false;
 
-    // 2. Load Card Infos
-    if (!persist_exists(PERSIST_KEY_COUNT)) {
-        g_card_count = 0;
-        return;
+    int version = persist_read_int(KEY_STORAGE_VERSION);
+    if (version == 1) storage_migrate_v1();
+    else if (version != STORAGE_VERSION) storage_migrate_legacy();
+
+    // 2. Load the card refs; menu rows are paged in as they are drawn
+    window_reset();
+    int len = record_read(REFS_KEY, REFS_KEYS, RECORD_REFS, g_card_refs, sizeof(CardRef) * MAX_CARDS);
+    bool valid = (len == (int)sizeof(CardRef) * MAX_CARDS);
+    int count = 0;
+    while (valid && count < MAX_CARDS && g_card_refs[count].slot != REF_SLOT_NONE) {
+        valid = g_card_refs[count].slot < MAX_CARDS;
+        count++;
+    }
+    if (valid) {
+        g_card_count = count;
+    } else {
+        index_rebuild();
     }
-    g_card_count = persist_read_int(PERSIST_KEY_COUNT);
-    if (g_card_count > MAX_CARDS) g_card_count = MAX_CARDS;
 
-    for (int i = 0; i < g_card_count; i++) {
-        persist_read_data(PERSIST_KEY_BASE + (i * KEYS_PER_CARD), &g_card_infos[i], sizeof(WalletCardInfo));
+    // Fixed-size records are written before any card, so cards filling the
+    // quota never leave them unwritable (the refs in index_rebuild)
+    if (!persist_exists(USAGE_KEY)) {
+        usage_load();
+        s_usage_dirty = true;
+        usage_flush();
     }
 }
 
 void storage_save_settings(void) {
     persist_write_bool(KEY_SETTING_INVERT, g_invert_colors);
+    persist_write_bool(KEY_SETTING_SORT, g_sort_by_use);
+    persist_write_int(KEY_SETTING_QUICK_LAUNCH, g_quick_launch);
 }
 
-void storage_load_card_data(int index, uint8_t *buffer, int max_len) {
-    if (!buffer || index < 0 || index >= g_card_count) return;
-    int base_key = PERSIST_KEY_BASE + (index * KEYS_PER_CARD);
-    
-    int total_read = 0;
-    for (int k=1; k < KEYS_PER_CARD; k++) {
-         int chunk_key = base_key + k;
-         if (persist_exists(chunk_key)) {
-             int read = persist_read_data(chunk_key, buffer + total_read, STORAGE_CHUNK_SIZE);
-             total_read += read;
-         } else break;
-    }
+// The description isn't stored; the menu row's subtitle stands for it
+bool storage_load_card_info(int index, WalletCardInfo *info) {
+    InfoRecord r;
+    if (!info || index < 0 || index >= g_card_count || !load_info_slot(g_card_refs[index].slot, &r)) return false;
+    memset(info, 0, sizeof(*info));
+    info->format = (BarcodeFormat)r.row.format;
+    info->width = r.row.width;
+    info->height = r.row.height;
+    info->encoding = r.encoding;
+    memcpy(info->name, r.row.name, INDEX_NAME_LEN);
+    return true;
 }
 
-void storage_save_card(int index, WalletCardInfo *info, const uint8_t *bits, int bits_len) {
-    if (index < 0 || index >= MAX_CARDS) return;
-    int base_key = PERSIST_KEY_BASE + (index * KEYS_PER_CARD);
-    persist_write_data(base_key, info, sizeof(WalletCardInfo));
+int storage_load_card_data(int index, uint8_t *buffer, int max_len) {
+    if (!buffer || index < 0 || index >= g_card_count) return 0;
+    return record_read(DATA_KEY(g_card_refs[index].slot), DATA_KEYS, RECORD_DATA, buffer, max_len);
+}
 
-    int offset = 0;
-    for (int k=1; k < KEYS_PER_CARD; k++) {
-        int chunk_key = base_key + k;
-        if (offset < bits_len) {
-            int remaining = bits_len - offset;
-            int write_len = (remaining > STORAGE_CHUNK_SIZE) ? STORAGE_CHUNK_SIZE : remaining;
-            persist_write_data(chunk_key, bits + offset, write_len);
-            offset += write_len;
-        } else if (persist_exists(chunk_key)) persist_delete(chunk_key);
+static bool card_write(int slot, const WalletCardInfo *info, const uint8_t *bits, int bits_len) {
+    return info_write(slot, info) && record_write(DATA_KEY(slot), DATA_KEYS, RECORD_DATA, bits, bits_len);
+}
+
+// Display lists and menu pages are rebuilt from the cards, so they make room
+// for a card that doesn't fit. Pages in RAM are written again once changed.
+static void drop_caches(void) {
+    for (int slot = 0; slot < MAX_CARDS; slot++) record_delete(DLIST_KEY(slot), 0, DLIST_KEYS);
+    for (int p = 0; p < INDEX_PAGES; p++) record_delete(PAGE_KEY(p), 0, 1);
+}
+
+// Cards past the current count (a full sync after CMD_SYNC_START) get a free slot.
+// False when the card doesn't fit in the persist quota even after the caches
+// made room: nothing of it is kept, and a card it replaces is gone too.
+bool storage_save_card(int index, WalletCardInfo *info, const uint8_t *bits, int bits_len, uint32_t hash) {
+    if (index < 0 || index >= MAX_CARDS || index > g_card_count) return false;
+    int slot = (index < g_card_count) ? g_card_refs[index].slot : free_slot(g_card_count);
+    if (slot < 0) return false;
+    if (bits_len > MAX_BITS_LEN) bits_len = MAX_BITS_LEN;
+    record_delete(DLIST_KEY(slot), 0, DLIST_KEYS); // Drew what the slot held before
+    bool stored = card_write(slot, info, bits, bits_len);
+    if (!stored) {
+        drop_caches();
+        stored = card_write(slot, info, bits, bits_len);
+    }
+    if (!stored) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Card %d not stored: storage full", index);
+        delete_slot(slot);
+        if (index < g_card_count) {
+            g_card_refs[index].hash = CARD_HASH_NONE; // Ask for it again on the next sync
+            s_refs_dirty = true;
+        }
+        return false;
     }
+    index_set_entry(index, slot, hash, info);
+    return true;
 }
 
+#if WALLET_DISPLAY_LISTS
+// Display lists are a cache of the card bits, written after the cards of a
+// sync: when one doesn't fit in the persist quota it is dropped and the card
+// is rendered from its bits instead.
+bool storage_save_display_list(int index, const uint8_t *dlist, int len) {
+    if (index < 0 || index >= g_card_count) return false;
+    int slot = g_card_refs[index].slot;
+    if (dlist && len > 0 && len <= DLIST_MAX_LEN &&
+        record_write(DLIST_KEY(slot), DLIST_KEYS, RECORD_DLIST, dlist, len)) return true;
+
+    if (len > 0) APP_LOG(APP_LOG_LEVEL_WARNING, "Display list %d not stored", index);
+    record_delete(DLIST_KEY(slot), 0, DLIST_KEYS);
+    return false;
+}
+
+int storage_load_display_list(int index, uint8_t *buffer, int max_len) {
+    if (!buffer || index < 0 || index >= g_card_count) return 0;
+    return record_read(DLIST_KEY(g_card_refs[index].slot), DLIST_KEYS, RECORD_DLIST, buffer, max_len);
+}
+#endif
+
 void storage_save_count(int count) {
     if (count > MAX_CARDS) count = MAX_CARDS;
     g_card_count = count;
-    persist_write_int(PERSIST_KEY_COUNT, count);
+    s_refs_dirty = true;
+}
+
+// Keeps cards [0, count) and deletes the records of the rest, menu pages
+// left without a row included
+void storage_truncate(int count) {
+    if (count < 0) count = 0;
+    if (count >= g_card_count) return;
+    for (int i = count; i < g_card_count; i++) delete_slot(g_card_refs[i].slot);
+    for (int p = (count + INDEX_PAGE_ROWS - 1) / INDEX_PAGE_ROWS; p < INDEX_PAGES; p++) {
+        for (int i = 0; i < INDEX_WINDOW_PAGES; i++) {
+            if (s_window[i].page == p) s_window[i].page = -1;
+        }
+        record_delete(PAGE_KEY(p), 0, 1);
+    }
+    storage_save_count(count);
+}
+
+// FNV-1a over the card hashes in order (little-endian) and the invert,
+// menu order and quick launch settings; the phone computes the same over its cards (walletHash in
+// pebble-js-app.js) and skips the startup sync when the two match. A card
+// with an unknown hash (damaged, or a sync that was cut short) makes the
+// whole wallet unknown so the phone syncs. Never CARD_HASH_NONE otherwise.
+uint32_t storage_wallet_hash(void) {
+    uint32_t h = 0x811C9DC5;
+    for (int i = 0; i < g_card_count; i++) {
+        uint32_t card = g_card_refs[i].hash;
+        if (card == CARD_HASH_NONE) return CARD_HASH_NONE;
+        for (int b = 0; b < 4; b++) h = (h ^ ((card >> (8 * b)) & 0xFF)) * 16777619u;
+    }
+    h = (h ^ (g_invert_colors ? 1 : 0)) * 16777619u;
+    h = (h ^ (g_sort_by_use ? 1 : 0)) * 16777619u;
+    h = (h ^ g_quick_launch) * 16777619u;
+    return h ? h : 1;
+}
+
+// A card was shown in the detail window
+void storage_record_open(int index) {
+    if (index < 0 || index >= g_card_count) return;
+    usage_load();
+    int slot = g_card_refs[index].slot;
+    CardUsage *u = &s_usage[slot];
+    if (u->opens < UINT16_MAX) u->opens++;
+    u->day = time(NULL) / SECONDS_PER_DAY;
+    s_usage_dirty = true;
+    if (slot != s_last_slot) {
+        s_last_slot = slot;
+        persist_write_int(KEY_LAST_OPENED, slot);
+    }
+}
+
+CardUsage storage_card_usage(int index) {
+    CardUsage none = { 0, 0 };
+    if (index < 0 || index >= g_card_count) return none;
+    usage_load();
+    return s_usage[g_card_refs[index].slot];
 }
 
+int storage_last_opened(void) {
+    for (int i = 0; i < g_card_count; i++) {
+        if (g_card_refs[i].slot == s_last_slot) return i;
+    }
+    return -1;
+}
+
+// Deletes every card's records and their usage, so a full sync starts with
+// the quota back and its cards start with no opens
 void storage_clear_all(void) {
-    storage_save_count(0);
-}
\ No newline at end of file
+    legacy_discard();
+    storage_truncate(0);
+    usage_clear();
+    storage_flush_index();
+}
@@ -1,10 +1,35 @@
 // PebbleWallet Gemini - Binary Sync with Invert Support
 var CONFIG_URL = "https://mitokafander.github.io/PebbleWallet_Gemini/config/index.html";
 
+// Quick launch modes (QuickLaunchMode in common.h)
+var QUICK_LAUNCH_OFF = 0;
+var QUICK_LAUNCH_BUTTON = 1;
+var QUICK_LAUNCH_ALWAYS = 2;
+
+// Watch settings: invert, menu in most-used order, open the last card at launch
+function loadSettings() {
+    return {
+        invert: JSON.parse(localStorage.getItem('invert') || 'false'),
+        sortByUse: JSON.parse(localStorage.getItem('sortByUse') || 'false'),
+        quickLaunch: JSON.parse(localStorage.getItem('quickLaunch') || String(QUICK_LAUNCH_OFF))
+    };
+}
+
+// Sent with CMD_SYNC_MANIFEST and CMD_SYNC_START
+function settingsDict(settings, dict) {
+    dict['KEY_INVERT'] = settings.invert ? 1 : 0;
+    dict['KEY_SORT'] = settings.sortByUse ? 1 : 0;
+    dict['KEY_QUICK_LAUNCH'] = settings.quickLaunch;
+    return dict;
+}
+
 Pebble.addEventListener('showConfiguration', function() {
+    var settings = loadSettings();
     var data = {
         cards: JSON.parse(localStorage.getItem('cards') || '[]'),
-        invert: JSON.parse(localStorage.getItem('invert') || 'false')
+        invert: settings.invert,
+        sortByUse: settings.sortByUse,
+        quickLaunch: settings.quickLaunch
     };
     Pebble.openURL(CONFIG_URL + '#' + encodeURIComponent(JSON.stringify(data)));
 });
@@ -14,28 +39,250 @@ Pebble.addEventListener('webviewclosed', function(e) {
     var data = JSON.parse(decodeURIComponent(e.response));
     
     localStorage.setItem('cards', JSON.stringify(data.cards));
-    localStorage.setItem('invert', JSON.stringify(data.invert));
+    localStorage.setItem('invert', JSON.stringify(!!data.invert));
+    localStorage.setItem('sortByUse', JSON.stringify(!!data.sortByUse));
+    localStorage.setItem('quickLaunch', JSON.stringify(data.quickLaunch || QUICK_LAUNCH_OFF));
     
-    syncToWatch(data.cards, data.invert);
+    syncToWatch(data.cards, loadSettings());
 });
 
-function syncToWatch(cards, invert) {
-    // Send SYNC_START with the Invert setting
-    Pebble.sendAppMessage({ 
-        'CMD_SYNC_START': 1,
-        'KEY_INVERT': invert ? 1 : 0
-    }, function() {
-        sendNextCard(cards, 0);
-    });
+// Delta sync: send the content hash of every card first. The watch keeps the
+// cards it already has (even if they moved) and replies with KEY_NEEDED, a
+// bitmask of the indexes it still needs; only those cards are sent.
+var pendingMessages = null;
+var pendingHashes = null;
+var MAX_CARDS = 20; // MAX_CARDS in common.h
+// The wallet being synced and its card transfer, for KEY_STORAGE_FULL
+var syncHashes = [];
+var syncSettings = null;
+var cardTransfer = null;
+
+// The config page won't save more than MAX_CARDS; a wallet saved before it
+// checked is sent up to the limit, and the watch says what was left out
+function syncToWatch(cards, settings) {
+    if (cards.length > MAX_CARDS) {
+        console.log('Wallet has ' + cards.length + ' cards; the watch holds ' + MAX_CARDS);
+        Pebble.showSimpleNotificationOnPebble('Gemini Wallet',
+            'The watch holds ' + MAX_CARDS + ' cards: ' + (cards.length - MAX_CARDS) +
+            ' after card ' + MAX_CARDS + ' were not synced.');
+        cards = cards.slice(0, MAX_CARDS);
+    }
+    var messages = [];
+    var hashes = [];
+    for (var i = 0; i < cards.length; i++) {
+        messages.push(buildCardMessage(cards[i], i));
+        hashes.push(hashCardMessage(messages[i]));
+    }
+    syncHashes = hashes;
+    syncSettings = settings;
+
+    if (messages.length === 0) {
+        // Nothing to hash: a full sync of no cards clears the watch
+        localStorage.setItem('walletHash', walletHash(hashes, settings));
+        streamMessages([{ dict: settingsDict(settings, { 'CMD_SYNC_START': 1 }), barrier: true }], function() {
+            sendCards([], []);
+        });
+        return;
+    }
+
+    localStorage.setItem('walletHash', walletHash(hashes, settings));
+
+    var manifest = [];
+    for (var j = 0; j < hashes.length; j++) {
+        var h = hashes[j];
+        manifest.push(h & 0xFF, (h >>> 8) & 0xFF, (h >>> 16) & 0xFF, (h >>> 24) & 0xFF);
+    }
+    pendingMessages = messages;
+    pendingHashes = hashes;
+    // The watch answers with KEY_NEEDED
+    streamMessages([{ dict: settingsDict(settings, { 'CMD_SYNC_MANIFEST': manifest }), barrier: true }],
+                   function() {});
 }
 
-function sendNextCard(cards, index) {
-    if (index >= cards.length) {
-        Pebble.sendAppMessage({ 'CMD_SYNC_COMPLETE': 1 });
+// Hash of the whole wallet as the watch stores it (storage_wallet_hash in
+// storage.c): FNV-1a over the card hashes in order, then the settings.
+function walletHash(hashes, settings) {
+    var h = 0x811C9DC5;
+    function add(b) {
+        h = (h ^ (b & 0xFF)) >>> 0;
+        h = (h + (h << 1) + (h << 4) + (h << 7) + (h << 8) + (h << 24)) >>> 0;
+    }
+    for (var i = 0; i < hashes.length; i++) {
+        add(hashes[i]); add(hashes[i] >>> 8); add(hashes[i] >>> 16); add(hashes[i] >>> 24);
+    }
+    add(settings.invert ? 1 : 0);
+    add(settings.sortByUse ? 1 : 0);
+    add(settings.quickLaunch);
+    return h || 1;
+}
+
+// At startup the watch sends the hash of what it has stored. When it matches
+// the last wallet synced from here the watch is told it is up to date;
+// otherwise (or when this phone has not synced since the handshake was added)
+// the delta sync runs. A phone that was never configured has nothing to send
+// and must not wipe the watch, so it reports up to date too.
+function answerFetch(watchHash) {
+    var configured = localStorage.getItem('cards') !== null;
+    var ours = parseInt(localStorage.getItem('walletHash'));
+    if (!configured || (watchHash !== undefined && !isNaN(ours) && (watchHash >>> 0) === ours)) {
+        streamMessages([{ dict: { 'CMD_SYNC_UP_TO_DATE': 1 }, barrier: true }], function() {});
         return;
     }
-    
-    var c = cards[index];
+    syncToWatch(JSON.parse(localStorage.getItem('cards') || '[]'), loadSettings());
+}
+
+Pebble.addEventListener('appmessage', function(e) {
+    var inboxSize = e.payload['KEY_INBOX_SIZE'];
+    if (inboxSize) localStorage.setItem('inboxSize', inboxSize);
+
+    if (e.payload['CMD_FETCH_CONFIG'] !== undefined) {
+        answerFetch(e.payload['KEY_WALLET_HASH']);
+        return;
+    }
+
+    if (e.payload['KEY_STORAGE_FULL'] !== undefined) {
+        storageFull(e.payload['KEY_STORAGE_FULL']);
+        return;
+    }
+
+    var needed = e.payload['KEY_NEEDED'];
+    if (needed === undefined || !pendingMessages) return;
+
+    var messages = pendingMessages;
+    var hashes = pendingHashes;
+    pendingMessages = pendingHashes = null;
+    var queue = [];
+    for (var i = 0; i < messages.length; i++) {
+        if (needed[i >> 3] & (1 << (i & 7))) {
+            messages[i]['KEY_HASH'] = hashes[i] | 0;
+            queue.push(messages[i]);
+        }
+    }
+    sendCards(queue, hashes);
+});
+
+// The watch ran out of persist storage at card `stored`: it keeps the cards
+// before it and ignores the rest of this sync. What it now reports at
+// startup is the hash of those cards, so that is what counts as synced;
+// otherwise every launch would resend the wallet and fail the same way.
+// Changing the wallet syncs again.
+function storageFull(stored) {
+    if (cardTransfer) cardTransfer.stop();
+    cardTransfer = null;
+    localStorage.setItem('walletHash', walletHash(syncHashes.slice(0, stored), syncSettings || loadSettings()));
+    console.log('Watch storage full: ' + stored + ' of ' + syncHashes.length + ' cards stored');
+    Pebble.showSimpleNotificationOnPebble('Gemini Wallet',
+        'Watch storage is full: ' + stored + ' of ' + syncHashes.length + ' cards fit.');
+}
+
+// Streaming transfer: up to SEND_WINDOW messages are queued at once so the
+// link never idles waiting for an ACK, and a failed message is resent on its
+// own. A card bigger than the watch inbox goes as a header followed by
+// CMD_SYNC_DATA chunks; the header waits for everything before it and its
+// chunks wait for the header, so the watch only reassembles one card at a time.
+var SEND_WINDOW = 4;
+var SEND_RETRIES = 5;
+var RETRY_DELAY_MS = 250;
+var DEFAULT_INBOX_SIZE = 512; // Smallest inbox the watch asks for
+var DICT_HEADER = 1;
+var TUPLE_HEADER = 7;
+
+function sendCards(queue, hashes) {
+    var inboxSize = parseInt(localStorage.getItem('inboxSize')) || DEFAULT_INBOX_SIZE;
+    var transfer = [];
+    for (var i = 0; i < queue.length; i++) {
+        transfer = transfer.concat(splitCardMessage(queue[i], inboxSize));
+    }
+    transfer.push({ dict: { 'CMD_SYNC_COMPLETE': 1 }, barrier: true });
+
+    cardTransfer = streamMessages(transfer, function() {
+        cardTransfer = null;
+        localStorage.setItem('cardHashes', JSON.stringify(hashes));
+    });
+}
+
+function dictSize(dict) {
+    var size = DICT_HEADER;
+    for (var key in dict) {
+        var v = dict[key];
+        if (typeof v === 'string') size += TUPLE_HEADER + unescape(encodeURIComponent(v)).length + 1;
+        else if (v instanceof Array) size += TUPLE_HEADER + v.length;
+        else size += TUPLE_HEADER + 4;
+    }
+    return size;
+}
+
+function splitCardMessage(dict, inboxSize) {
+    if (dictSize(dict) <= inboxSize) return [{ dict: dict, barrier: false }];
+
+    var data = dict['KEY_DATA'];
+    var header = {};
+    for (var key in dict) {
+        if (key !== 'KEY_DATA') header[key] = dict[key];
+    }
+    // Chunk messages carry CMD_SYNC_DATA, KEY_INDEX and KEY_SEQ
+    var chunkSize = inboxSize - DICT_HEADER - 3 * TUPLE_HEADER - 2 * 4;
+    header['KEY_DATA_LEN'] = data.length;
+    header['KEY_CHUNK_SIZE'] = chunkSize;
+
+    var out = [{ dict: header, barrier: true }];
+    for (var seq = 0; seq * chunkSize < data.length; seq++) {
+        out.push({
+            dict: {
+                'CMD_SYNC_DATA': data.slice(seq * chunkSize, (seq + 1) * chunkSize),
+                'KEY_INDEX': dict['KEY_INDEX'],
+                'KEY_SEQ': seq
+            },
+            barrier: false
+        });
+    }
+    return out;
+}
+
+function streamMessages(messages, done) {
+    var next = 0;
+    var inFlight = 0;
+    var blocked = false;
+    var failed = false;
+
+    function send(m) {
+        Pebble.sendAppMessage(m.dict, function() {
+            inFlight--;
+            if (m.barrier) blocked = false;
+            pump();
+        }, function() {
+            if (++m.tries > SEND_RETRIES) {
+                failed = true;
+                console.log('Sync failed: watch did not accept a message');
+                return;
+            }
+            setTimeout(function() { if (!failed) send(m); }, RETRY_DELAY_MS * m.tries);
+        });
+    }
+
+    function pump() {
+        if (failed) return;
+        while (!blocked && inFlight < SEND_WINDOW && next < messages.length) {
+            var m = messages[next];
+            if (m.barrier && inFlight > 0) break;
+            next++;
+            m.tries = 0;
+            inFlight++;
+            if (m.barrier) blocked = true;
+            send(m);
+        }
+        if (next >= messages.length && inFlight === 0) done();
+    }
+    pump();
+    return { stop: function() { failed = true; } };
+}
+
+// Each card goes either as its source text, encoded on the watch, or as the
+// pre-rendered modules from the config page: text when the watch can encode
+// it and it is no bigger. The watch encodes text when it draws the card (a
+// QR or Aztec symbol once, the last one is cached); persist quota is the
+// scarcer resource, so only the size is weighed.
+function buildCardMessage(c, index) {
     var dict = {
         'KEY_INDEX': index,
         'KEY_NAME': c.name,
@@ -43,32 +290,239 @@ function sendNextCard(cards, index) {
         'KEY_FORMAT': parseInt(c.format)
     };
 
-    if (c.data.indexOf(',') > -1) {
-        var parts = c.data.split(',');
-        var rawW = parseInt(parts[0]);
-        var rawH = parseInt(parts[1]);
-        var hex = parts[2];
-        
-        // OPTIMIZATION: Crop whitespace to allow larger scaling on watch
-        var optimized = cropBitmap(rawW, rawH, hex);
-        
-        dict['KEY_WIDTH'] = optimized.width;
-        dict['KEY_HEIGHT'] = optimized.height;
-        var bytes = [];
-        for (var i = 0; i < optimized.hex.length; i += 2) bytes.push(parseInt(optimized.hex.substr(i, 2), 16));
-        dict['KEY_DATA'] = bytes;
+    var text = cardText(c);
+    var bitmap = cardBitmap(c) ? bitmapPayload(cardBitmap(c)) : null;
+    var textBytes = watchCanEncode(dict['KEY_FORMAT'], text) ? asciiBytes(text) : null;
+
+    if (textBytes && (!bitmap || textBytes.length <= bitmap.data.length)) {
+        dict['KEY_WIDTH'] = 0; dict['KEY_HEIGHT'] = 0;
+        dict['KEY_ENCODING'] = ENCODING_TEXT;
+        dict['KEY_DATA'] = textBytes;
+    } else if (bitmap) {
+        dict['KEY_WIDTH'] = bitmap.width;
+        dict['KEY_HEIGHT'] = bitmap.height;
+        dict['KEY_ENCODING'] = bitmap.encoding;
+        dict['KEY_DATA'] = bitmap.data;
     } else {
+        // No modules to fall back on (a card from an old config page): the
+        // watch tries the text and says why it can't draw it
         dict['KEY_WIDTH'] = 0; dict['KEY_HEIGHT'] = 0;
+        dict['KEY_ENCODING'] = ENCODING_TEXT;
         var bytes = [];
-        for (var i = 0; i < c.data.length; i++) bytes.push(c.data.charCodeAt(i));
+        for (var i = 0; i < text.length; i++) bytes.push(text.charCodeAt(i) & 0xFF);
         dict['KEY_DATA'] = bytes;
     }
+    return dict;
+}
 
-    Pebble.sendAppMessage(dict, function() {
-        sendNextCard(cards, index + 1);
-    }, function(e) {
-        setTimeout(function() { sendNextCard(cards, index); }, 1000);
-    });
+// Config pages before `text`/`bitmap` kept one of them in `data`, the
+// bitmap as "width,height,hex"
+function cardText(c) {
+    if (c.text) return c.text;
+    return (c.data && c.data.indexOf(',') === -1) ? c.data : '';
+}
+
+function cardBitmap(c) {
+    if (c.bitmap) return c.bitmap;
+    return (c.data && c.data.indexOf(',') > -1) ? c.data : '';
+}
+
+// "width,height,hex" cropped and sent in whichever encoding is smaller; the
+// watch decodes both
+function bitmapPayload(bitmap) {
+    var parts = bitmap.split(',');
+    // OPTIMIZATION: Crop whitespace to allow larger scaling on watch
+    var optimized = cropBitmap(parseInt(parts[0]), parseInt(parts[1]), parts[2]);
+    var bytes = [];
+    for (var i = 0; i < optimized.hex.length; i += 2) bytes.push(parseInt(optimized.hex.substr(i, 2), 16));
+
+    var rle = encodeRowRle(optimized.width, optimized.height, bytes);
+    var useRle = rle.length < bytes.length;
+    return {
+        width: optimized.width,
+        height: optimized.height,
+        encoding: useRle ? ENCODING_ROW_RLE : ENCODING_PACKED,
+        data: useRle ? rle : bytes
+    };
+}
+
+function asciiBytes(text) {
+    var bytes = [];
+    for (var i = 0; i < text.length; i++) {
+        var code = text.charCodeAt(i);
+        if (code < 1 || code > 127) return null;
+        bytes.push(code);
+    }
+    return bytes;
+}
+
+// Mirrors what the watch encoders accept (linear.c, qr.c, aztec.c); anything
+// else goes as the config page's modules. ASCII only: the watch stores text
+// as bytes. 1D codes are also held to what fits the smallest screen (see
+// layout_1d): longer ones can't be drawn whichever way they are sent.
+var WATCH_MAX_1D_LEN = 100;     // MAX_DATA_LEN
+var WATCH_MAX_1D_MODULES = 148; // 168px screen less two 10-module quiet zones
+var WATCH_QR_MAX = { numeric: 652, alnum: 395, byte: 271 }; // Version 10, level L
+var WATCH_AZTEC_MAX_BYTES = 53; // Compact, 4 layers, whatever the characters
+var QR_ALNUM = /^[0-9A-Z $%*+\-.\/:]*$/;
+var CODE39_CHARS = /^[0-9A-Z\-. $\/+%]*$/;
+
+function eanCheckDigit(digits) {
+    var sum = 0;
+    for (var i = 0; i < digits.length; i++) {
+        sum += parseInt(digits.charAt(digits.length - 1 - i)) * (i % 2 === 0 ? 3 : 1);
+    }
+    return (10 - sum % 10) % 10;
+}
+
+// EAN/UPC: `n` digits with the check digit, or n - 1 without; spaces and
+// hyphens are skipped
+function eanValid(text, n) {
+    var digits = text.replace(/[ \-]/g, '');
+    if (!/^[0-9]+$/.test(digits)) return false;
+    if (digits.length === n - 1) return true;
+    return digits.length === n && eanCheckDigit(digits.substr(0, n - 1)) === parseInt(digits.charAt(n - 1));
+}
+
+// Code 128 modules as the watch encodes them: the fewest symbols over sets
+// A, B and C with SHIFT and set switches (c128_plan_step in linear.c), plus
+// start, checksum and the 13-module stop
+function code128Modules(text) {
+    var A = 0, B = 1, C = 2, INF = 1e9;
+    var next1 = [0, 0, 0], next2 = [0, 0, 0];
+    function inSet(c, set) { return set === A ? c < 96 : c >= 32; }
+    function isDigit(c) { return c >= 48 && c <= 57; }
+    for (var i = text.length - 1; i >= 0; i--) {
+        var c = text.charCodeAt(i);
+        var stay = [INF, INF, INF];
+        for (var set = A; set <= B; set++) {
+            if (inSet(c, set)) stay[set] = 1 + next1[set];
+            else if (inSet(c, 1 - set)) stay[set] = 2 + next1[set]; // SHIFT
+        }
+        if (i + 1 < text.length && isDigit(c) && isDigit(text.charCodeAt(i + 1))) stay[C] = 1 + next2[C];
+        var cost = [];
+        for (var s = A; s <= C; s++) {
+            cost[s] = Math.min(stay[s], 1 + Math.min(stay[(s + 1) % 3], stay[(s + 2) % 3]));
+        }
+        next2 = next1;
+        next1 = cost;
+    }
+    return (2 + Math.min(next1[A], next1[B], next1[C])) * 11 + 13;
+}
+
+function code39Modules(text) {
+    return (text.length + 2) * 16 - 1; // 15 per character plus the gap
+}
+
+// Aplite is built without the encoders (WALLET_TEXT_ENCODERS in common.h).
+// Modules draw everywhere, so they also go when the platform is unknown.
+function watchHasEncoders() {
+    var info = Pebble.getActiveWatchInfo ? Pebble.getActiveWatchInfo() : null;
+    return !!(info && info.platform && info.platform !== 'aplite');
+}
+
+function watchCanEncode(format, text) {
+    if (!text || !asciiBytes(text) || !watchHasEncoders()) return false;
+    switch (format) {
+        case 0: return text.length <= WATCH_MAX_1D_LEN && code128Modules(text) <= WATCH_MAX_1D_MODULES;
+        case 1: return code39Modules(text) <= WATCH_MAX_1D_MODULES && CODE39_CHARS.test(text.toUpperCase());
+        case 2: return eanValid(text, 13);                                  // EAN-13
+        case 6: return eanValid(text, 12);                                  // UPC-A
+        case 7: return eanValid(text, 8);                                   // EAN-8
+        case 3:                                                             // QR
+            if (/^[0-9]*$/.test(text)) return text.length <= WATCH_QR_MAX.numeric;
+            if (QR_ALNUM.test(text)) return text.length <= WATCH_QR_MAX.alnum;
+            return text.length <= WATCH_QR_MAX.byte;
+        case 4: return text.length <= WATCH_AZTEC_MAX_BYTES;                // Aztec
+        default: return false;                                              // PDF417
+    }
+}
+
+// FNV-1a over everything the watch stores for a card (not its index, so a
+// moved card keeps its hash). Never 0: that means "unknown" on the watch.
+function hashCardMessage(dict) {
+    var h = 0x811C9DC5;
+    function add(b) {
+        h = (h ^ (b & 0xFF)) >>> 0;
+        // h * 16777619 without losing precision
+        h = (h + (h << 1) + (h << 4) + (h << 7) + (h << 8) + (h << 24)) >>> 0;
+    }
+    function addString(str) {
+        var utf8 = unescape(encodeURIComponent(str));
+        for (var i = 0; i < utf8.length; i++) add(utf8.charCodeAt(i));
+        add(0);
+    }
+    add(dict['KEY_FORMAT']);
+    add(dict['KEY_WIDTH']); add(dict['KEY_WIDTH'] >> 8);
+    add(dict['KEY_HEIGHT']); add(dict['KEY_HEIGHT'] >> 8);
+    add(dict['KEY_ENCODING'] || ENCODING_PACKED);
+    addString(dict['KEY_NAME']);
+    addString(dict['KEY_DESCRIPTION']);
+    var data = dict['KEY_DATA'];
+    for (var i = 0; i < data.length; i++) add(data[i]);
+    return h || 1;
+}
+
+// Card encodings (CardEncoding in common.h)
+var ENCODING_PACKED = 0;
+var ENCODING_ROW_RLE = 1;
+var ENCODING_TEXT = 2;
+
+function pushVarint(out, v) {
+    while (v >= 0x80) {
+        out.push((v & 0x7F) | 0x80);
+        v = v >>> 7;
+    }
+    out.push(v);
+}
+
+// Row RLE: groups of identical rows. Each group is a varint (repeat << 1 | raw)
+// followed by either the row's alternating white/black run lengths (starting
+// with white) or, when that is shorter, the row's packed bits.
+function encodeRowRle(width, height, bytes) {
+    function bit(idx) {
+        return (bytes[idx >> 3] >> (7 - (idx & 7))) & 1;
+    }
+    function sameRow(a, b) {
+        for (var x = 0; x < width; x++) {
+            if (bit(a * width + x) !== bit(b * width + x)) return false;
+        }
+        return true;
+    }
+
+    var out = [];
+    var y = 0;
+    while (y < height) {
+        var repeat = 1;
+        while (y + repeat < height && sameRow(y, y + repeat)) repeat++;
+
+        var runs = [];
+        var color = 0;
+        var x = 0;
+        while (x < width) {
+            var run = 0;
+            while (x + run < width && bit(y * width + x + run) === color) run++;
+            pushVarint(runs, run);
+            x += run;
+            color ^= 1;
+        }
+
+        var rawLen = Math.ceil(width / 8);
+        if (rawLen < runs.length) {
+            pushVarint(out, repeat * 2 + 1);
+            var raw = [];
+            for (var k = 0; k < rawLen; k++) raw.push(0);
+            for (var x2 = 0; x2 < width; x2++) {
+                if (bit(y * width + x2)) raw[x2 >> 3] |= 1 << (7 - (x2 & 7));
+            }
+            out = out.concat(raw);
+        } else {
+            pushVarint(out, repeat * 2);
+            out = out.concat(runs);
+        }
+        y += repeat;
+    }
+    return out;
 }
 
 // Helper to remove white borders from bitmap data